@@ -17,9 +17,10 @@ void *disk_addr(u_int blockno) {
 }
 
 // Overview:
-//  Check if this virtual address is mapped to a block. (check PTE_V bit)
+//  Check if this virtual address is mapped to a block. (check PTE_V bit, or PTE_SWAP for a
+//  cached block the kernel has swapped out)
 int va_is_mapped(void *va) {
-	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & PTE_V);
+	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & (PTE_V | PTE_SWAP));
 }
 
 // Overview:
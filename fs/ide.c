@@ -13,12 +13,13 @@
  */
 static uint8_t wait_ide_ready() {
 	uint8_t flag;
+	u_int delay = POLL_MIN_DELAY;
 	while (1) {
 		panic_on(syscall_read_dev(&flag, MALTA_IDE_STATUS, 1));
 		if ((flag & MALTA_IDE_BUSY) == 0) {
 			break;
 		}
-		syscall_yield();
+		poll_wait(&delay);
 	}
 	return flag;
 }
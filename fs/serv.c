@@ -120,25 +120,49 @@ int open_lookup(u_int envid, u_int fileid, struct Open **po) {
  * Functions with the prefix "serve_" are those who
  * conduct the file system requests from clients.
  * The file system receives the requests by function
- * `ipc_recv`, when the requests are received, the
+ * `ipc_reply_and_recv`, when the requests are received, the
  * file system will call the corresponding `serve_`
  * and return the result to the caller by function
- * `ipc_send`.
+ * `serve_reply`.
  */
 
+/*
+ * The reply to the request being served, sent by `serve` along with
+ * receiving the next request. No reply is pending if r_envid is 0.
+ * Clients must wait for it in `ipc_call`: the server never blocks
+ * on a single client, and drops a reply nobody waits for.
+ */
+static struct {
+	u_int r_envid;
+	u_int r_val;
+	void *r_srcva;
+	u_int r_perm;
+} reply;
+
+/*
+ * Overview:
+ *  Reply `val` (and the page at `srcva` if not NULL) to the request of `envid`.
+ */
+static void serve_reply(u_int envid, u_int val, void *srcva, u_int perm) {
+	reply.r_envid = envid;
+	reply.r_val = val;
+	reply.r_srcva = srcva;
+	reply.r_perm = perm;
+}
+
 /*
  * Overview:
  * Serve to open a file specified by the path in `rq`.
  * It will try to alloc an open descriptor, open the file
  * and then save the info in the File descriptor. If everything
- * is done, it will use the ipc_send to return the FileFd page
+ * is done, it will use the serve_reply to return the FileFd page
  * to the caller.
  * Parameters:
  * envid: the id of the request process.
  * rq: the request, which contains the path and the open mode.
  * Return:
- * if Success, return the FileFd page to the caller by ipc_send,
- * Otherwise, use ipc_send to return the error value to the caller.
+ * if Success, return the FileFd page to the caller by serve_reply,
+ * Otherwise, use serve_reply to return the error value to the caller.
  */
 void serve_open(u_int envid, struct Fsreq_open *rq) {
 	struct File *f;
@@ -148,19 +172,19 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 
 	// Find a file id.
 	if ((r = open_alloc(&o)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((rq->req_omode & O_CREAT) && (r = file_create(rq->req_path, &f)) < 0 &&
 	    r != -E_FILE_EXISTS) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	// Open the file.
 	if ((r = file_open(rq->req_path, &f)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
@@ -170,7 +194,7 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 	// If mode include O_TRUNC, set the file size to 0
 	if (rq->req_omode & O_TRUNC) {
 		if ((r = file_set_size(f, 0)) < 0) {
-			ipc_send(envid, r, 0, 0);
+			serve_reply(envid, r, 0, 0);
 		}
 	}
 
@@ -181,7 +205,7 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 	o->o_mode = rq->req_omode;
 	ff->f_fd.fd_omode = o->o_mode;
 	ff->f_fd.fd_dev_id = devfile.dev_id;
-	ipc_send(envid, 0, o->o_ff, PTE_D | PTE_LIBRARY);
+	serve_reply(envid, 0, o->o_ff, PTE_D | PTE_LIBRARY);
 }
 
 /*
@@ -189,12 +213,12 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
  *  Serve to map the file specified by the fileid in `rq`.
  *  It will use the fileid and envid to find the open file and
  *  then call the `file_get_block` to get the block and use
- *  the `ipc_send` to return the block to the caller.
+ *  the `serve_reply` to return the block to the caller.
  * Parameters:
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the offset.
  * Return:
- *  if Success, use ipc_send to return zero and  the block to
+ *  if Success, use serve_reply to return zero and  the block to
  *  the caller.Otherwise, return the error value to the caller.
  */
 void serve_map(u_int envid, struct Fsreq_map *rq) {
@@ -204,18 +228,18 @@ void serve_map(u_int envid, struct Fsreq_map *rq) {
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	filebno = rq->req_offset / BLOCK_SIZE;
 
 	if ((r = file_get_block(pOpen->o_file, filebno, &blk)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, blk, PTE_D | PTE_LIBRARY);
+	serve_reply(envid, 0, blk, PTE_D | PTE_LIBRARY);
 }
 
 /*
@@ -227,23 +251,23 @@ void serve_map(u_int envid, struct Fsreq_map *rq) {
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the size.
  * Return:
- * if Success, use ipc_send to return 0 to the caller. Otherwise,
+ * if Success, use serve_reply to return 0 to the caller. Otherwise,
  * return the error value to the caller.
  */
 void serve_set_size(u_int envid, struct Fsreq_set_size *rq) {
 	struct Open *pOpen;
 	int r;
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((r = file_set_size(pOpen->o_file, rq->req_size)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
@@ -255,7 +279,7 @@ void serve_set_size(u_int envid, struct Fsreq_set_size *rq) {
  *  envid: the id of the request process.
  * 	rq: the request, which contains the fileid.
  * Return:
- *  if Success, use ipc_send to return 0 to the caller.Otherwise,
+ *  if Success, use serve_reply to return 0 to the caller.Otherwise,
  *  return the error value to the caller.
  */
 void serve_close(u_int envid, struct Fsreq_close *rq) {
@@ -264,24 +288,24 @@ void serve_close(u_int envid, struct Fsreq_close *rq) {
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	file_close(pOpen->o_file);
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
  * Overview:
  *  Serve to remove a file specified by the path in `req`.
  *  It calls the `file_remove` to remove the file and then use
- *  the `ipc_send` to return the result to the caller.
+ *  the `serve_reply` to return the result to the caller.
  * Parameters:
  *  envid: the id of the request process.
  *  rq: the request, which contains the path.
  * Return:
- *  the result of the file_remove to the caller by ipc_send.
+ *  the result of the file_remove to the caller by serve_reply.
  */
 void serve_remove(u_int envid, struct Fsreq_remove *rq) {
 	// Step 1: Remove the file specified in 'rq' using 'file_remove' and store its return value.
@@ -289,9 +313,9 @@ void serve_remove(u_int envid, struct Fsreq_remove *rq) {
 	/* Exercise 5.11: Your code here. (1/2) */
 	r = file_remove(rq->req_path);
 
-	// Step 2: Respond the return value to the caller 'envid' using 'ipc_send'.
+	// Step 2: Respond the return value to the caller 'envid' using 'serve_reply'.
 	/* Exercise 5.11: Your code here. (2/2) */
-	ipc_send(envid, r, 0, 0);
+	serve_reply(envid, r, 0, 0);
 }
 
 /*
@@ -303,7 +327,7 @@ void serve_remove(u_int envid, struct Fsreq_remove *rq) {
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the offset.
  * `Return`:
- *  if Success, use ipc_send to return 0 to the caller. Otherwise,
+ *  if Success, use serve_reply to return 0 to the caller. Otherwise,
  *  return the error value to the caller.
  */
 void serve_dirty(u_int envid, struct Fsreq_dirty *rq) {
@@ -311,28 +335,28 @@ void serve_dirty(u_int envid, struct Fsreq_dirty *rq) {
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((r = file_dirty(pOpen->o_file, rq->req_offset)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
  * Overview:
  *  Serve to sync the file system.
  *  it calls the `fs_sync` to sync the file system.
- *  and then use the `ipc_send` and `return` 0 to tell the caller
+ *  and then use the `serve_reply` and `return` 0 to tell the caller
  *  file system is synced.
  */
 void serve_sync(u_int envid) {
 	fs_sync();
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 void serve_create(u_int envid, struct Fsreq_create *rq)
@@ -341,11 +365,11 @@ void serve_create(u_int envid, struct Fsreq_create *rq)
 	struct File *file;
 	if ((r = file_create(rq->req_path, &file)) < 0)
 	{
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 	file->f_type = rq->type;
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
@@ -379,7 +403,9 @@ void serve(void) {
 	for (;;) {
 		perm = 0;
 
-		req = ipc_recv(&whom, (void *)REQVA, &perm);
+		req = ipc_reply_and_recv(reply.r_envid, reply.r_val, reply.r_srcva, reply.r_perm,
+					 &whom, (void *)REQVA, &perm);
+		reply.r_envid = 0;
 
 		// All requests must contain an argument page
 		if (!(perm & PTE_V)) {
@@ -414,6 +440,9 @@ int main() {
 
 	debugf("FS is running\n");
 
+	// Serve requests ahead of CPU-bound envs.
+	panic_on(syscall_set_priority(0, SCHED_LEVEL_SERVER));
+
 	serve_init();
 	fs_init();
 
@@ -49,4 +49,11 @@
 #define STATUS_ERL 0x0004
 #define STATUS_EXL 0x0002
 #define STATUS_IE 0x0001
+
+// Exception codes, in bits 6..2 of CP0_CAUSE.
+#define EXC_INT 0
+#define EXC_MOD 1
+#define EXC_TLBL 2
+#define EXC_TLBS 3
+#define EXC_SYS 8
 #endif
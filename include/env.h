@@ -3,6 +3,7 @@
 
 #include <mmu.h>
 #include <queue.h>
+#include <smp.h>
 #include <trap.h>
 #include <types.h>
 
@@ -17,6 +18,43 @@
 
 extern char cur_path[128]; // current working directory path
 
+// Memory used by an env, kept up to date by 'page_insert' and 'page_remove' (see 'page_account').
+struct Env_mem {
+	u_int em_resident; // pages mapped below UTOP
+	u_int em_ptpages;  // page tables, and the page directory
+	u_int em_shared;   // resident pages with more than one reference
+	u_int em_cow;	   // resident pages mapped copy-on-write
+};
+
+// Memory statistics of an env, as reported to user space by 'sys_mem_stat'.
+struct Mem_stat {
+	struct Env_mem ms_env;
+	u_int ms_free;	// free physical pages
+	u_int ms_total; // all physical pages
+};
+
+/*
+ * Kernel data mapped read-only at 'UKDATA' in every env, so user space can read it without a
+ * syscall. 'uk_clock' and 'uk_curenv' are updated whenever the kernel returns to user mode or
+ * goes idle, 'uk_ticks' and 'uk_loadavg' at the end of every clock tick.
+ */
+struct Ukdata {
+	u_int uk_seq;		 // odd while 'uk_clock' is being updated
+	uint64_t uk_clock;	 // CP0_COUNT cycles since boot ('kclock_now') at the last update
+	u_int uk_ticks;		 // clock ticks since boot
+	u_int uk_runnable;	 // runnable envs
+	u_int uk_loadavg;	 // 'uk_runnable' averaged over ~'1 << UK_LOAD_DECAY' ticks
+	u_int uk_curenv;	 // the id of the running env, 0 if idle
+};
+
+// 'uk_loadavg' is fixed-point with 'UK_LOAD_SHIFT' fractional bits.
+#define UK_LOAD_SHIFT 11
+#define UK_LOAD_DECAY 7
+
+extern struct Ukdata *ukdata;
+
+TAILQ_HEAD(Env_sched_list, Env);
+
 // Control block of an environment (process).
 struct Env {
 	struct Trapframe env_tf;	 // saved context (registers) before switching
@@ -26,8 +64,20 @@ struct Env {
 	u_int env_parent_id;		 // env_id of this env's parent
 	u_int env_status;		 // status of this env
 	Pde *env_pgdir;			 // page directory
-	TAILQ_ENTRY(Env) env_sched_link; // intrusive entry in 'env_sched_list'
-	u_int env_pri;			 // schedule priority
+	TAILQ_ENTRY(Env) env_sched_link; // intrusive entry in a run queue
+	u_int env_pri;			 // schedule priority (time slice length)
+	u_int env_level;		 // base run queue level
+	u_int env_qlevel;		 // current run queue level, raised by aging
+	uint64_t env_vruntime;		 // virtual runtime (with 'MOS_SCHED=cfs')
+	u_int env_heapx;		 // index in the run heap, 0 if not runnable (ditto)
+
+	// Timed sleep
+	LIST_ENTRY(Env) env_timer_link; // intrusive entry in a timer wheel slot
+	uint64_t env_wakeup;		// CP0_COUNT cycle to wake up at, 0 if not sleeping
+
+	// Futex wait
+	TAILQ_ENTRY(Env) env_futex_link; // intrusive entry in a futex hash bucket
+	u_long env_futex_key;		 // physical address of the word waited on, 0 if not waiting
 
 	// Lab 4 IPC
 	u_int env_ipc_value;   // the value sent to us
@@ -35,6 +85,16 @@ struct Env {
 	u_int env_ipc_recving; // whether this env is blocked receiving
 	u_int env_ipc_dstva;   // va at which the received page should be mapped
 	u_int env_ipc_perm;    // perm in which the received page should be mapped
+	u_int env_ipc_wakee;   // envid of the receiver we last woke, run when we block receiving
+	u_int env_ipc_callee;  // in 'sys_ipc_call', the envid whose reply we wait for, or 0
+
+	// Blocking IPC send
+	struct Env_sched_list env_ipc_senders; // envs blocked sending to us, longest waiting first
+	TAILQ_ENTRY(Env) env_ipc_send_link;    // intrusive entry in the receiver's 'env_ipc_senders'
+	struct Env *env_ipc_send_to;	       // the receiver we are blocked sending to, or NULL
+	u_int env_ipc_send_value;	       // the message we are blocked sending
+	u_int env_ipc_send_srcva;
+	u_int env_ipc_send_perm;
 
 	// Lab 4 fault handling
 	u_int env_user_tlb_mod_entry; // userspace TLB Mod handler
@@ -42,16 +102,28 @@ struct Env {
 	// Lab 6 scheduler counts
 	u_int env_runs; // number of times we've been env_run'ed
 
+	// CPU time, in CP0_COUNT cycles
+	uint64_t env_utime;  // in user mode
+	uint64_t env_ktime;  // in the kernel, on our behalf
+	uint64_t env_cutime; // 'env_utime' of our dead children and their descendants
+	uint64_t env_cktime; // 'env_ktime' of our dead children and their descendants
+
 	// shell ID
 	int env_shell_id;
 	// 本环境自己的环境变量链表
 	struct Var *env_vars;
+
+	// Memory accounting
+	struct Env_mem env_mem;
+
+	// Syscall statistics (see include/sysstat.h), allocated on our first syscall
+	struct Sysstat_env *env_sysstat;
 };
 
 LIST_HEAD(Env_list, Env);
-TAILQ_HEAD(Env_sched_list, Env);
-extern struct Env *curenv;		     // the current env
-extern struct Env_sched_list env_sched_list; // runnable env list
+#define curenv (cpu_this()->cpu_env) // the current env
+// The trapframe saved when this CPU entered the kernel from user mode.
+#define cur_tf ((struct Trapframe *)cpu_this()->cpu_kstacktop - 1)
 
 void env_init(void);
 int env_alloc(struct Env **e, u_int parent_id);
@@ -60,6 +132,9 @@ struct Env *env_create(const void *binary, size_t size, int priority);
 void env_destroy(struct Env *e);
 
 int envid2env(u_int envid, struct Env **penv, int checkperm);
+void ipc_cancel(struct Env *e);
+void ipc_interrupt(struct Env *e);
+void ipc_drop_senders(struct Env *e);
 void env_run(struct Env *e) __attribute__((noreturn));
 
 void env_check(void);
@@ -97,6 +172,7 @@ int envvar_declare(struct Env *env, const char *name, const char *value, int per
 int envvar_unset(struct Env *env, const char *name);
 int envvar_get(struct Env *env, const char *name, char *value, int bufsize);
 int envvar_getall(struct Env *env, char *buf, int bufsize);
+void envvar_free_all(struct Env *env);
 
 /* 当父进程创建子进程时，只复制父进程中 owner==0 的全局变量到子进程 */
 void env_copy_vars(struct Env *child, struct Env *parent);
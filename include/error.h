@@ -44,6 +44,9 @@
 // File not a valid executable
 #define E_NOT_EXEC 13
 
+// The futex word didn't hold the expected value
+#define E_AGAIN 14
+
 /*
  * A quick wrapper around function calls to propagate errors.
  * Use this with caution, as it leaks resources we've acquired so far.
@@ -0,0 +1,18 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <env.h>
+
+/*
+ * Envs waiting on a futex are queued, in the order they started waiting, in a hash bucket of
+ * the physical address of the word, so envs mapping the same page at different addresses
+ * rendezvous on it.
+ */
+#define FUTEX_NBUCKETS 64
+
+void futex_init(void);
+void futex_block(struct Env *e, u_long key);
+void futex_cancel(struct Env *e);
+int futex_wake(u_long key, u_int n);
+
+#endif
@@ -1,25 +1,34 @@
 #ifndef _KCLOCK_H_
 #define _KCLOCK_H_
 
-#include <asm/asm.h>
-
 #define TIMER_INTERVAL (500000) // WARNING: DO NOT MODIFY THIS LINE!
 
-// clang-format off
-.macro RESET_KCLOCK
-	li 	t0, TIMER_INTERVAL
-	/*
-	 * Hint:
-	 *   Use 'mtc0' to write an appropriate value into the CP0_COUNT and CP0_COMPARE registers.
-	 *   Writing to the CP0_COMPARE register will clear the timer interrupt.
-	 *   The CP0_COUNT register increments at a fixed frequency. When the values of CP0_COUNT and
-	 *   CP0_COMPARE registers are equal, the timer interrupt will be triggered.
-	 *
-	 */
-	/* Exercise 3.11: Your code here. */
-	mtc0 zero, CP0_COUNT
-	mtc0 t0, CP0_COMPARE
-
-.endm
-// clang-format on
+#define KCLOCK_HZ 100000000 // CP0_COUNT runs at 100 MHz in QEMU
+
+// Compare is never programmed further ahead than this, so every wrap of CP0_COUNT is seen.
+#define KCLOCK_MAX_INTERVAL 0x40000000
+// A deadline closer than this (or already passed) is programmed this far ahead instead, so the
+// interrupt can't be missed.
+#define KCLOCK_MIN_INTERVAL 64
+
+#ifndef __ASSEMBLER__
+
+#include <types.h>
+
+struct Env;
+struct Trapframe;
+
+#define KCLOCK_NEVER ((uint64_t)-1)
+
+uint64_t kclock_now(void);
+void kclock_start_slice(void);
+void kclock_reload(void);
+void kclock_idle(void) __attribute__((noreturn));
+void do_timer(void);
+
+void acct_enter(struct Trapframe *tf);
+void acct_exit(struct Trapframe *tf);
+void acct_forget(struct Env *e);
+
+#endif /* !__ASSEMBLER__ */
 #endif
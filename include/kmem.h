@@ -0,0 +1,69 @@
+#ifndef _KMEM_H_
+#define _KMEM_H_
+
+#include <queue.h>
+#include <types.h>
+
+#define KMEM_NAME_LEN 16
+
+// Statistics of one object cache, as reported to user space by 'sys_kmem_info'.
+struct Kmem_info {
+	char ki_name[KMEM_NAME_LEN]; // name of the cache
+	u_int ki_objsize;	     // size of an object in bytes (after alignment)
+	u_int ki_objs_per_slab;	     // number of objects in a one-page slab
+	u_int ki_slabs;		     // number of slabs (pages) owned by the cache
+	u_int ki_inuse;		     // number of allocated objects
+	u_int ki_allocs;	     // total successful allocations
+	u_int ki_frees;		     // total frees
+	u_int ki_fails;		     // allocations failed for lack of memory
+};
+
+LIST_HEAD(Slab_list, Slab);
+LIST_HEAD(Kmem_cache_list, Kmem_cache);
+
+/*
+ * A slab is exactly one physical page. This header lives at the beginning of the page and the
+ * objects follow it, so the slab of any object is found by rounding its address down to
+ * 'PAGE_SIZE'.
+ */
+struct Slab {
+	LIST_ENTRY(Slab) s_link;    // entry in one of the lists of 's_cache'
+	struct Kmem_cache *s_cache; // the cache owning this slab
+	void *s_free;		    // singly-linked list of free objects
+	u_short s_inuse;	    // number of allocated objects in this slab
+	u_short s_static;	    // donated boot memory, never released to 'page_free_list'
+};
+
+// An object cache: a set of slabs holding objects of a single size.
+struct Kmem_cache {
+	const char *kc_name;
+	u_int kc_objsize;	 // requested object size, rounded up by 'kmem_cache_setup'
+	u_int kc_objs_per_slab;	 // 0 until the cache is set up on first use
+	struct Slab_list kc_partial; // slabs with both free and allocated objects
+	struct Slab_list kc_full;    // slabs without free objects
+	struct Slab_list kc_empty;   // slabs without allocated objects
+	u_int kc_nempty;	     // number of non-static slabs in 'kc_empty'
+	struct Kmem_info kc_stat;
+	LIST_ENTRY(Kmem_cache) kc_link; // entry in 'kmem_caches'
+};
+
+/*
+ * Statically define a cache of objects of 'size' bytes. Caches need no explicit initialization,
+ * they are set up and registered in 'kmem_caches' on their first allocation.
+ */
+#define KMEM_CACHE_INITIALIZER(name, size)                                                         \
+	{ .kc_name = (name), .kc_objsize = (size) }
+
+extern struct Kmem_cache_list kmem_caches;
+
+void *kmem_cache_alloc(struct Kmem_cache *cache);
+void kmem_cache_free(struct Kmem_cache *cache, void *obj);
+void kmem_cache_donate(struct Kmem_cache *cache, void *mem, u_int npages);
+
+void *kmalloc(size_t size);
+void kfree(void *obj);
+
+int kmem_info(struct Kmem_info *buf, u_int n);
+void kmem_check(void);
+
+#endif // !_KMEM_H_
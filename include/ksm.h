@@ -0,0 +1,38 @@
+#ifndef _KSM_H_
+#define _KSM_H_
+
+#include <pmap.h>
+
+/*
+ * Kernel same-page merging: a scanner run from the clock interrupt finds user pages with equal
+ * content and maps them all to one read-only copy-on-write page.
+ */
+
+// Pages examined per clock tick by default, see 'sys_ksm_ctl'.
+#define KSM_DEFAULT_RATE 32
+// Upper bound of the rate, so that a tick never stalls the machine.
+#define KSM_MAX_RATE 1024
+// Buckets of the stable and unstable hash tables.
+#define KSM_NBUCKETS 256
+// A merged page is not shared by more mappings than this, 'pp_ref' must not overflow.
+#define KSM_MAX_SHARING 4096
+
+// KSM statistics, as reported to user space by 'sys_ksm_ctl'.
+// The scan counters describe the last complete pass over all physical pages.
+struct Ksm_info {
+	u_int ks_rate;	  // pages examined per clock tick, 0 if the scanner is stopped
+	u_int ks_runs;	  // complete passes over all physical pages
+	u_int ks_scanned; // candidate pages hashed in the last pass
+	u_int ks_merged;  // mappings redirected to a merged page in the last pass
+	u_int ks_shared;  // merged pages at the end of the last pass
+	u_int ks_sharing; // mappings of merged pages beyond the first one, i.e. pages saved
+	u_int ks_zero;	  // mappings of the zero page (by read faults, or merged zero-filled pages)
+};
+
+extern struct Ksm_info ksm_stat;
+
+void ksm_tick(void);
+void ksm_scan(u_int n);
+void ksm_set_rate(u_int rate);
+
+#endif // !_KSM_H_
@@ -32,9 +32,23 @@
 #define MALTA_IDE_STATUS (MALTA_IDE_BASE + 0x07)
 #define MALTA_IDE_LBA 0xE0
 #define MALTA_IDE_BUSY 0x80
+#define MALTA_IDE_DRQ 0x08
+#define MALTA_IDE_ERROR 0x01
 #define MALTA_IDE_CMD_PIO_READ 0x20  /* Read sectors with retry */
 #define MALTA_IDE_CMD_PIO_WRITE 0x30 /* write sectors with retry */
 
+/*
+ * The secondary channel of the same controller, reserved for the kernel (swap).
+ */
+#define MALTA_IDE2_BASE (MALTA_PCIIO_BASE + 0x0170)
+#define MALTA_IDE2_DATA (MALTA_IDE2_BASE + 0x00)
+#define MALTA_IDE2_NSECT (MALTA_IDE2_BASE + 0x02)
+#define MALTA_IDE2_LBAL (MALTA_IDE2_BASE + 0x03)
+#define MALTA_IDE2_LBAM (MALTA_IDE2_BASE + 0x04)
+#define MALTA_IDE2_LBAH (MALTA_IDE2_BASE + 0x05)
+#define MALTA_IDE2_DEVICE (MALTA_IDE2_BASE + 0x06)
+#define MALTA_IDE2_STATUS (MALTA_IDE2_BASE + 0x07)
+
 /*
  * MALTA Power Management device definitions.
  */
@@ -6,6 +6,8 @@
  */
 
 #define NASID 256
+// Ranges spanning this many TLB entries are invalidated by dropping all entries of their ASID.
+#define TLB_FLUSH_PAIRS 16
 #define PAGE_SIZE 4096
 #define PTMAP PAGE_SIZE
 #define PDMAP (4 * 1024 * 1024) // bytes mapped by a page directory entry
@@ -65,6 +67,13 @@
 // Shared memmory. Reserved for software, used by fork.
 #define PTE_LIBRARY 0x0002
 
+// Swapped out. Reserved for kernel, only meaningful without PTE_V: the PPN field of such an
+// entry holds the swap slot of the page, the other flags are those of the original mapping.
+#define PTE_SWAP 0x0008
+
+// Referenced since the last CLOCK scan. Reserved for kernel, set by TLB refill.
+#define PTE_REF 0x0010
+
 // Memory segments (32-bit kernel mode addresses)
 #define KUSEG 0x00000000U
 #define KSEG0 0x80000000U
@@ -95,7 +104,9 @@
  o      UVPT     -----> +----------------------------+------------0x7fc0 0000    |
  o                      |           pages            |     PDMAP                 |
  o      UPAGES   -----> +----------------------------+------------0x7f80 0000    |
- o                      |           envs             |     PDMAP                 |
+ o                      |        kernel data         |     PTMAP                 |
+ o      UKDATA   -----> +----------------------------+------------0x7f7f f000    |
+ o                      |           envs             | PDMAP - PTMAP             |
  o  UTOP,UENVS   -----> +----------------------------+------------0x7f40 0000    |
  o  UXSTACKTOP -/       |     user exception stack   |     PTMAP                 |
  o                      +----------------------------+------------0x7f3f f000    |
@@ -128,6 +139,7 @@
 #define UVPT (ULIM - PDMAP)
 #define UPAGES (UVPT - PDMAP)
 #define UENVS (UPAGES - PDMAP)
+#define UKDATA (UPAGES - PTMAP) // 'struct Ukdata', after 'envs'
 
 #define UTOP UENVS
 #define UXSTACKTOP UTOP
@@ -183,6 +195,9 @@ typedef u_long Pte;
 	})
 
 extern void tlb_out(u_int entryhi);
+extern void tlb_flush_asid(u_int asid);
 void tlb_invalidate(u_int asid, u_long va);
+void tlb_batch_begin(u_int asid);
+void tlb_batch_end(void);
 #endif //!__ASSEMBLER__
 #endif // !_MMU_H_
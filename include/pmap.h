@@ -4,12 +4,14 @@
 #include <mmu.h>
 #include <printk.h>
 #include <queue.h>
+#include <smp.h>
 #include <types.h>
 
-extern Pde *cur_pgdir;
+#define cur_pgdir (cpu_this()->cpu_pgdir)
 
 LIST_HEAD(Page_list, Page);
 typedef LIST_ENTRY(Page) Page_LIST_entry_t;
+LIST_HEAD(Rmap_list, Rmap);
 
 struct Page {
 	Page_LIST_entry_t pp_link; /* free list link */
@@ -20,11 +22,31 @@ struct Page {
 	// do not have valid reference count fields.
 
 	u_short pp_ref;
+
+	// Set iff. the page is in the stable table of the KSM scanner (see kern/ksm.c).
+	u_short pp_ksm;
+
+	// Reverse mappings: every page table entry mapping this page through 'page_insert', or for a
+	// page table shared by 'fork', every page directory using it.
+	struct Rmap_list pp_rmap;
+
+	// Content hash taken when the KSM scanner last visited this page.
+	u_int pp_checksum;
+
+	// For a page table: its entries which keep it from being shared by 'fork' (see
+	// 'pgdir_fork'), i.e. mappings of shared memory ('PTE_LIBRARY') and swapped out pages.
+	u_short pp_noshare;
 };
 
 extern struct Page *pages;
 extern struct Page_list page_free_list;
 
+// The shared zero page, mapped read-only with 'PTE_COW' on read faults of untouched memory.
+// It holds a permanent reference, and has no reverse mappings since it's never reclaimed.
+extern struct Page *zero_page;
+// Past this many references, read faults get private pages: 'pp_ref' must not overflow.
+#define ZERO_PAGE_MAX_REF 0xf000
+
 static inline u_long page2ppn(struct Page *pp) {
 	return pp - pages;
 }
@@ -70,6 +92,17 @@ void page_decref(struct Page *pp);
 int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm);
 struct Page *page_lookup(Pde *pgdir, u_long va, Pte **ppte);
 void page_remove(Pde *pgdir, u_int asid, u_long va);
+int cow_break(Pde *pgdir, u_int asid, u_long va);
+int pgdir_fork(Pde *src, u_int srcasid, Pde *dst, u_int dstasid, u_long limit);
+int pgtable_shared(Pde *pgdir, u_long va);
+int pgtable_unshare(Pde *pgdir, u_int asid, u_long va);
+int pgtable_leave(Pde *pgdir, u_long va);
+
+struct Env_mem;
+void page_account_bind(u_int asid, Pde *pgdir, struct Env_mem *em);
+void page_account(Pde *pgdir, u_int asid, struct Page *pp, u_long va, Pte pte, int n);
+void pgdir_account_shared(Pde *pgdir, struct Env_mem *em);
+u_int page_free_count(void);
 
 extern struct Page *pages;
 
@@ -0,0 +1,41 @@
+#ifndef _RMAP_H_
+#define _RMAP_H_
+
+#include <pmap.h>
+
+// Number of boot pages given to the rmap cache, so that early mappings never need 'page_alloc'.
+#define RMAP_RESERVE_PAGES 2
+
+/*
+ * A reverse mapping: the page table 'rm_pgdir' maps the owning page at 'RMAP_VA(rm)'.
+ * The ASID passed to 'page_insert' is kept in the low bits of 'rm_vaasid', so a mapping can be
+ * removed (and its TLB entry invalidated) without knowing the env which owns 'rm_pgdir'.
+ */
+struct Rmap {
+	LIST_ENTRY(Rmap) rm_link; // entry in 'pp_rmap' of the mapped page
+	Pde *rm_pgdir;
+	u_long rm_vaasid;
+};
+
+#define RMAP_VA(rm) ROUNDDOWN((rm)->rm_vaasid, PAGE_SIZE)
+#define RMAP_ASID(rm) ((rm)->rm_vaasid & (PAGE_SIZE - 1))
+
+/*
+ * Callback of 'rmap_foreach'. A non-zero return value stops the walk and is returned to the
+ * caller. The callback may remove the mapping it is called for, but no other.
+ */
+typedef int (*rmap_fn_t)(struct Page *pp, Pde *pgdir, u_int asid, u_long va, void *arg);
+
+void rmap_init(void);
+int rmap_add(struct Page *pp, Pde *pgdir, u_int asid, u_long va);
+void rmap_remove(struct Page *pp, Pde *pgdir, u_long va);
+void rmap_move(struct Page *pp, Pde *pgdir, u_long va, Pde *npgdir, u_int nasid);
+
+int rmap_foreach(struct Page *pp, rmap_fn_t fn, void *arg);
+int page_mapcount(struct Page *pp);
+int page_unmap_all(struct Page *pp);
+
+void rmap_report(void);
+void rmap_check(void);
+
+#endif // !_RMAP_H_
@@ -1,6 +1,46 @@
 #ifndef __SCHED_H__
 #define __SCHED_H__
 
+#include <env.h>
+#include <kclock.h>
+
+/*
+ * Runnable envs are kept in one queue per level; a higher level always runs first.
+ * 'env_pri' is the length of the time slice (in clock ticks), 'env_level' the base level.
+ */
+#define SCHED_NLEVELS 8
+#define SCHED_LEVEL_DEFAULT 2
+#define SCHED_LEVEL_SERVER 6
+
+// Every 'SCHED_AGING_TICKS' ticks, the env waiting longest at each level below the highest
+// non-empty one moves up one level, until it runs and drops back to its base level.
+#define SCHED_AGING_TICKS 8
+
+/*
+ * With 'MOS_SCHED=cfs' (see mk/profiles.mk), the runnable env with the least virtual runtime
+ * runs instead (kern/sched_cfs.c). An env's virtual runtime grows by its CPU time scaled by
+ * 'SCHED_WEIGHT_DEFAULT / weight', where its weight is '1 << (SCHED_WEIGHT_SHIFT + env_level)',
+ * so each level gets twice the share of the one below. 'env_pri' is not used.
+ */
+#define SCHED_WEIGHT_SHIFT 8
+#define SCHED_WEIGHT_DEFAULT (1 << (SCHED_WEIGHT_SHIFT + SCHED_LEVEL_DEFAULT))
+// Every runnable env runs once within this many ticks, each for at least one tick.
+#define SCHED_LATENCY_TICKS 4
+// A waking env may be this far (in CP0_COUNT cycles) behind the least virtual runtime.
+#define SCHED_WAKEUP_CREDIT (SCHED_LATENCY_TICKS * TIMER_INTERVAL / 2)
+// A new env starts this far ahead of the least virtual runtime, so forking gives no credit.
+#define SCHED_FORK_DEBIT TIMER_INTERVAL
+// 'curenv' is only preempted by an env this far ahead of it.
+#define SCHED_WAKEUP_GRAN (TIMER_INTERVAL / 5)
+
+void sched_init(void);
+void sched_insert(struct Env *e, int head);
+void sched_remove(struct Env *e);
+void sched_set_level(struct Env *e, u_int level);
+void sched_tick(void);
+int sched_need_preempt(void);
+
 void schedule(int yield) __attribute__((noreturn));
+void sched_handoff(struct Env *e) __attribute__((noreturn));
 
 #endif /* __SCHED_H__ */
@@ -0,0 +1,53 @@
+#ifndef __SMP_H__
+#define __SMP_H__
+
+#include <mmu.h>
+
+/*
+ * Per-CPU state and the big kernel lock, the groundwork for running on several CPUs. Only the
+ * boot CPU, CPU 0, is supported so far, and the lock compiles to nothing. It's taken on every
+ * exception entry (kern/entry.S), and released on the way back to user mode (kern/genex.S,
+ * 'env_run') or into the idle loop ('kclock_idle').
+ * Going beyond one CPU needs a way to start the others and to interrupt them, which the 4Kc
+ * model QEMU runs here doesn't have, and the exception entry to find the kernel stack of its CPU
+ * in 'cpu_kstacktop' rather than at 'KSTACKTOP'.
+ */
+#define NCPU 1
+
+#ifdef __ASSEMBLER__
+
+.macro LOCK_KERNEL
+.endm
+
+.macro UNLOCK_KERNEL
+.endm
+
+#else
+
+struct Env;
+
+struct Cpu {
+	struct Env *cpu_env;  // the env running on this CPU ('curenv')
+	Pde *cpu_pgdir;	      // its address space ('cur_pgdir')
+	u_long cpu_kstacktop; // the top of its kernel stack, below which 'cur_tf' is saved
+};
+
+extern struct Cpu cpus[NCPU];
+
+static inline u_int cpu_id(void) {
+	return 0;
+}
+
+static inline struct Cpu *cpu_this(void) {
+	return &cpus[cpu_id()];
+}
+
+static inline void lock_kernel(void) {
+}
+
+static inline void unlock_kernel(void) {
+}
+
+#endif /* !__ASSEMBLER__ */
+
+#endif /* __SMP_H__ */
@@ -0,0 +1,37 @@
+#ifndef _SWAP_H_
+#define _SWAP_H_
+
+#include <pmap.h>
+
+/*
+ * The swap area is the whole disk attached as master of the secondary IDE channel
+ * (target/swap.img), one page per slot.
+ */
+#define SWAP_NSLOTS 32768 // 128 MiB
+#define SWAP_SECT_SIZE 512
+#define SWAP_SECT_PER_PAGE (PAGE_SIZE / SWAP_SECT_SIZE)
+
+// 'swap_balance' swaps out pages when fewer than this many pages are free.
+#define SWAP_LOW_WATER 32
+// Maximum number of pages written by one IDE command.
+#define SWAP_BATCH 16
+
+// Swap statistics, as reported to user space by 'sys_swap_info'.
+struct Swap_info {
+	u_int si_slots;	   // size of the swap area in pages, 0 if there's no swap disk
+	u_int si_used;	   // slots holding a page
+	u_int si_pageouts; // pages written to swap
+	u_int si_pageins;  // pages read back from swap
+	u_int si_writes;   // IDE write commands issued for page-outs
+	u_int si_scanned;  // pages visited by the CLOCK hand
+};
+
+extern struct Swap_info swap_stat;
+
+void swap_init(void);
+int swap_out(u_int n);
+void swap_balance(void);
+int swap_in(Pde *pgdir, u_int asid, u_long va);
+void swap_free(Pte pte);
+
+#endif // !_SWAP_H_
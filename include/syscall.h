@@ -1,6 +1,9 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 
+// Size of 'syscall_fast_table', above every syscall number.
+#define SYSCALL_FAST_LIMIT 64
+
 #ifndef __ASSEMBLER__
 
 enum
@@ -31,9 +34,38 @@ enum
 	SYS_get_var,
 	SYS_get_all_var,
 	SYS_get_parent_id,
+	SYS_kmem_info,
+	SYS_swap_info,
+	SYS_ksm_ctl,
+	SYS_mem_stat,
+	SYS_set_priority,
+	SYS_sleep,
+	SYS_gettime,
+	SYS_futex_wait,
+	SYS_futex_wake,
+	SYS_multicall,
+	SYS_mem_alloc_range,
+	SYS_mem_map_range,
+	SYS_mem_unmap_range,
+	SYS_fork,
+	SYS_spawn,
+	SYS_sysstat,
+	SYS_ipc_call,
+	SYS_ipc_reply_and_recv,
+	SYS_ipc_send,
 	MAX_SYSNO,
 };
 
+// Largest number of syscalls in a batch run by 'sys_multicall'.
+#define MULTICALL_MAX 32
+
+// A syscall in a batch run by 'sys_multicall'.
+struct Multicall {
+	u_int mc_sysno;
+	u_int mc_args[5];
+	int mc_result; // set when run
+};
+
 #endif
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef _SYSSTAT_H_
+#define _SYSSTAT_H_
+
+#include <error.h>
+#include <syscall.h>
+#include <types.h>
+
+/*
+ * Syscall statistics: the calls of each syscall and the CP0_COUNT cycles spent in them, with
+ * log2 histograms of their latencies, per env and for all envs. A syscall lasts from
+ * its trap until the kernel returns to user mode or goes idle, so the time an env spends blocked
+ * in it is not counted. 'MOS_SYSSTAT=n' (see mk/profiles.mk) compiles them out.
+ */
+
+// Bucket 'i' counts the calls of '[2^i, 2^(i+1))' cycles; the first one also counts those of
+// no cycle, the last one all the longer ones.
+#define SYSSTAT_NBUCKETS 24
+
+struct Sysstat_call {
+	u_int sc_count;	   // calls
+	uint64_t sc_cycles; // cycles spent in them
+};
+
+// Syscall statistics, as reported to user space by 'sys_sysstat'.
+struct Sysstat {
+	struct Sysstat_call ss_env[MAX_SYSNO];		 // of the env asked for
+	struct Sysstat_call ss_all[MAX_SYSNO];		 // of all envs since boot
+	u_int ss_env_hist[MAX_SYSNO][SYSSTAT_NBUCKETS]; // of the env asked for
+	u_int ss_hist[MAX_SYSNO][SYSSTAT_NBUCKETS];	 // of all envs since boot
+};
+
+struct Env;
+
+#ifndef MOS_NO_SYSSTAT
+void sysstat_begin(u_int sysno);
+void sysstat_end(void);
+void sysstat_fast(u_int sysno, u_int start);
+void sysstat_forget(struct Env *e);
+int sysstat_get(struct Env *e, struct Sysstat *buf);
+#else
+static inline void sysstat_begin(u_int sysno) {
+}
+static inline void sysstat_end(void) {
+}
+static inline void sysstat_fast(u_int sysno, u_int start) {
+}
+static inline void sysstat_forget(struct Env *e) {
+}
+static inline int sysstat_get(struct Env *e, struct Sysstat *buf) {
+	return -E_NO_SYS;
+}
+#endif
+
+#endif // !_SYSSTAT_H_
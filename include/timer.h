@@ -0,0 +1,21 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <env.h>
+
+/*
+ * Sleeping envs are kept in a hashed timer wheel: slot 'i' holds the envs whose wake-up time 'w'
+ * has '(w >> TIMER_WHEEL_SHIFT) % TIMER_WHEEL_SIZE == i', so each slot covers about 1.3 ms and
+ * the wheel turns around every 84 ms. Envs sleeping longer than that stay in their slot for
+ * several turns.
+ */
+#define TIMER_WHEEL_SIZE 64
+#define TIMER_WHEEL_SHIFT 17
+
+void timer_init(void);
+void timer_add(struct Env *e, uint64_t when);
+void timer_cancel(struct Env *e);
+void timer_run(uint64_t now);
+uint64_t timer_next(void);
+
+#endif
@@ -1,8 +1,11 @@
 #include <asm/asm.h>
 #include <env.h>
+#include <kmem.h>
+#include <rmap.h>
 #include <pmap.h>
 #include <printk.h>
 #include <sched.h>
+#include <swap.h>
 #include <trap.h>
 
 /*
@@ -45,6 +48,7 @@ void mips_init(u_int argc, char **argv, char **penv, u_int ram_low_size) {
 	mips_detect_memory(ram_low_size);
 	mips_vm_init();
 	page_init();
+	swap_init();
 
 	// lab3:
 	env_init();
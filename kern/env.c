@@ -1,22 +1,26 @@
 #include <asm/cp0regdef.h>
 #include <elf.h>
 #include <env.h>
+#include <futex.h>
+#include <kclock.h>
+#include <kmem.h>
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
 #include <sched.h>
+#include <sysstat.h>
+#include <timer.h>
 
 struct Env envs[NENV] __attribute__((aligned(PAGE_SIZE))); // All environments
+struct Ukdata *ukdata;					    // Mapped at 'UKDATA' in all envs
+
+_Static_assert(NENV * sizeof(struct Env) <= UKDATA - UENVS, "'envs' overlaps 'UKDATA'");
 
-struct Env *curenv = NULL;			  // the current env
 static struct Env_list env_free_list; // Free list
 
 // Initialize current directory to root.
 char cur_path[128] = "/";
 
-// Invariant: 'env' in 'env_sched_list' iff. 'env->env_status' is 'RUNNABLE'.
-struct Env_sched_list env_sched_list; // Runnable list
-
 static Pde *base_pgdir;
 
 static uint32_t asid_bitmap[NASID / 32] = {0};
@@ -164,11 +168,13 @@ int envid2env(u_int envid, struct Env **penv, int checkperm)
 void env_init(void)
 {
 	int i;
-	/* Step 1: Initialize 'env_free_list' with 'LIST_INIT' and 'env_sched_list' with
-	 * 'TAILQ_INIT'. */
+	/* Step 1: Initialize 'env_free_list' with 'LIST_INIT' and the run queues with
+	 * 'sched_init'. */
 	/* Exercise 3.1: Your code here. (1/2) */
 	LIST_INIT(&env_free_list);
-	TAILQ_INIT(&env_sched_list);
+	sched_init();
+	timer_init();
+	futex_init();
 
 	/* Step 2: Traverse the elements of 'envs' array, set their status to 'ENV_FREE' and insert
 	 * them into the 'env_free_list'. Make sure, after the insertion, the order of envs in the
@@ -184,7 +190,7 @@ void env_init(void)
 	/*
 	 * We want to map 'UPAGES' and 'UENVS' to *every* user space with PTE_G permission (without
 	 * PTE_D), then user programs can read (but cannot write) kernel data structures 'pages' and
-	 * 'envs'.
+	 * 'envs'. So is 'ukdata', at 'UKDATA'.
 	 *
 	 * Here we first map them into the *template* page directory 'base_pgdir'.
 	 * Later in 'env_setup_vm', we will copy them into each 'env_pgdir'.
@@ -198,6 +204,11 @@ void env_init(void)
 				ROUND(npage * sizeof(struct Page), PAGE_SIZE), PTE_G);
 	map_segment(base_pgdir, 0, PADDR(envs), UENVS, ROUND(NENV * sizeof(struct Env), PAGE_SIZE),
 				PTE_G);
+
+	panic_on(page_alloc(&p));
+	p->pp_ref++;
+	ukdata = (struct Ukdata *)page2kva(p);
+	map_segment(base_pgdir, 0, page2pa(p), UKDATA, PAGE_SIZE, PTE_G);
 }
 
 /* Overview:
@@ -282,6 +293,7 @@ int env_alloc(struct Env **new, u_int parent_id)
 	 */
 	e->env_user_tlb_mod_entry = 0; // for lab4
 	e->env_runs = 0;			   // for lab6
+	e->env_utime = e->env_ktime = e->env_cutime = e->env_cktime = 0;
 	/* Exercise 3.4: Your code here. (3/4) */
 	e->env_id = mkenvid(e);
 	e->env_parent_id = parent_id;
@@ -290,6 +302,14 @@ int env_alloc(struct Env **new, u_int parent_id)
 	{
 		return r;
 	}
+	e->env_level = e->env_qlevel = SCHED_LEVEL_DEFAULT;
+	e->env_vruntime = 0;
+	e->env_ipc_wakee = 0;
+	e->env_ipc_callee = 0;
+	TAILQ_INIT(&e->env_ipc_senders);
+	e->env_ipc_send_to = NULL;
+	e->env_mem = (struct Env_mem){.em_ptpages = 1};
+	page_account_bind(e->env_asid, e->env_pgdir, &e->env_mem);
 
 	/* Step 4: Initialize the sp and 'cp0_status' in 'e->env_tf'.
 	 *   Set the EXL bit to ensure that the processor remains in kernel mode during context
@@ -404,11 +424,11 @@ struct Env *env_create(const void *binary, size_t size, int priority)
 	e->env_pri = priority;
 	e->env_status = ENV_RUNNABLE;
 
-	/* Step 3: Use 'load_icode' to load the image from 'binary', and insert 'e' into
-	 * 'env_sched_list' using 'TAILQ_INSERT_HEAD'. */
+	/* Step 3: Use 'load_icode' to load the image from 'binary', and insert 'e' at the head of
+	 * its run queue using 'sched_insert'. */
 	/* Exercise 3.7: Your code here. (3/3) */
 	load_icode(e, binary, size);
-	TAILQ_INSERT_HEAD(&env_sched_list, e, env_sched_link);
+	sched_insert(e, 1);
 
 	return e;
 }
@@ -420,10 +440,20 @@ void env_free(struct Env *e)
 {
 	Pte *pt;
 	u_int pdeno, pteno, pa;
+	struct Env *parent;
+	int shared = 0;
 
 	/* Hint: Note the environment's demise.*/
 	printk("[%08x] free env %08x\n", curenv ? curenv->env_id : 0, e->env_id);
 
+	/* Hint: add our CPU time, and that of our dead children, to our parent. */
+	acct_forget(e);
+	if (e->env_parent_id != 0 && envid2env(e->env_parent_id, &parent, 0) == 0)
+	{
+		parent->env_cutime += e->env_utime + e->env_cutime;
+		parent->env_cktime += e->env_ktime + e->env_cktime;
+	}
+
 	/* Hint: Flush all mapped pages in the user portion of the address space */
 	for (pdeno = 0; pdeno < PDX(UTOP); pdeno++)
 	{
@@ -432,13 +462,22 @@ void env_free(struct Env *e)
 		{
 			continue;
 		}
+		/* A page table shared by 'fork' stays for the other envs using it, so its pages are
+		 * not unmapped one by one: their TLB entries are all dropped below instead. */
+		if (pgtable_leave(e->env_pgdir, pdeno << PDSHIFT))
+		{
+			e->env_pgdir[pdeno] = 0;
+			tlb_invalidate(e->env_asid, UVPT + (pdeno << PGSHIFT));
+			shared = 1;
+			continue;
+		}
 		/* Hint: find the pa and va of the page table. */
 		pa = PTE_ADDR(e->env_pgdir[pdeno]);
 		pt = (Pte *)KADDR(pa);
-		/* Hint: Unmap all PTEs in this page table. */
+		/* Hint: Unmap all PTEs in this page table, including swapped out pages. */
 		for (pteno = 0; pteno <= PTX(~0); pteno++)
 		{
-			if (pt[pteno] & PTE_V)
+			if (pt[pteno] & (PTE_V | PTE_SWAP))
 			{
 				page_remove(e->env_pgdir, e->env_asid,
 							(pdeno << PDSHIFT) | (pteno << PGSHIFT));
@@ -450,16 +489,28 @@ void env_free(struct Env *e)
 		/* Hint: invalidate page table in TLB */
 		tlb_invalidate(e->env_asid, UVPT + (pdeno << PGSHIFT));
 	}
+	if (shared)
+	{
+		tlb_flush_asid(e->env_asid);
+	}
 	/* Hint: free the page directory. */
 	page_decref(pa2page(PADDR(e->env_pgdir)));
 	/* Hint: free the ASID */
+	page_account_bind(e->env_asid, NULL, NULL);
 	asid_free(e->env_asid);
 	/* Hint: invalidate page directory in TLB */
 	tlb_invalidate(e->env_asid, UVPT + (PDX(UVPT) << PGSHIFT));
+	/* Hint: release the environment variables. */
+	envvar_free_all(e);
 	/* Hint: return the environment to the free list. */
 	e->env_status = ENV_FREE;
 	LIST_INSERT_HEAD((&env_free_list), (e), env_link);
-	TAILQ_REMOVE(&env_sched_list, (e), env_sched_link);
+	sched_remove(e);
+	timer_cancel(e);
+	futex_cancel(e);
+	ipc_cancel(e);
+	ipc_drop_senders(e);
+	sysstat_forget(e);
 }
 
 /* Overview:
@@ -512,7 +563,7 @@ void env_run(struct Env *e)
 	 */
 	if (curenv)
 	{
-		curenv->env_tf = *((struct Trapframe *)KSTACKTOP - 1);
+		curenv->env_tf = *cur_tf;
 	}
 
 	/* Step 2: Change 'curenv' to 'e'. */
@@ -532,6 +583,9 @@ void env_run(struct Env *e)
 	 *    returning to the kernel caller, making 'env_run' a 'noreturn' function as well.
 	 */
 	/* Exercise 3.8: Your code here. (2/2) */
+	kclock_reload();
+	acct_exit(&curenv->env_tf);
+	unlock_kernel();
 	env_pop_tf(&curenv->env_tf, curenv->env_asid);
 }
 
@@ -592,9 +646,9 @@ void env_check()
 	printk("pe2`s sp register %x\n", pe2->env_tf.regs[29]);
 
 	/* free all env allocated in this function */
-	TAILQ_INSERT_TAIL(&env_sched_list, pe0, env_sched_link);
-	TAILQ_INSERT_TAIL(&env_sched_list, pe1, env_sched_link);
-	TAILQ_INSERT_TAIL(&env_sched_list, pe2, env_sched_link);
+	sched_insert(pe0, 0);
+	sched_insert(pe1, 0);
+	sched_insert(pe2, 0);
 
 	env_free(pe2);
 	env_free(pe1);
@@ -626,35 +680,26 @@ void envid2env_check()
 }
 
 /* ---------------- 环境变量支持开始 ---------------- */
-#define MAX_VAR_COUNT 128
-static struct Var var_pool[MAX_VAR_COUNT];
-static int var_pool_used[MAX_VAR_COUNT] = {0};
+static struct Kmem_cache var_cache = KMEM_CACHE_INITIALIZER("var", sizeof(struct Var));
 
 /* 分配一个 Var 节点 */
 static struct Var *alloc_var(void)
 {
-	for (int i = 0; i < MAX_VAR_COUNT; i++)
-	{
-		if (!var_pool_used[i])
-		{
-			var_pool_used[i] = 1;
-			var_pool[i].name[0] = '\0';
-			var_pool[i].value[0] = '\0';
-			var_pool[i].perm = 0;
-			var_pool[i].owner = 0;
-			var_pool[i].next = 0;
-			return &var_pool[i];
-		}
-	}
-	return 0;
+	struct Var *v = kmem_cache_alloc(&var_cache);
+	if (!v)
+		return 0;
+	v->name[0] = '\0';
+	v->value[0] = '\0';
+	v->perm = 0;
+	v->owner = 0;
+	v->next = 0;
+	return v;
 }
 
 /* 释放一个 Var 节点 */
 static void free_var(struct Var *v)
 {
-	int index = v - var_pool;
-	if (index >= 0 && index < MAX_VAR_COUNT)
-		var_pool_used[index] = 0;
+	kmem_cache_free(&var_cache, v);
 }
 
 /* envvar_declare: 在指定 env->env_vars 链表中，声明或更新变量
@@ -787,3 +832,14 @@ void env_copy_vars(struct Env *child, struct Env *parent)
 		p = p->next;
 	}
 }
+
+/* envvar_free_all: 释放 env->env_vars 链表中的所有变量（env_free 时调用） */
+void envvar_free_all(struct Env *env)
+{
+	struct Var *v;
+	while ((v = env->env_vars) != 0)
+	{
+		env->env_vars = v->next;
+		free_var(v);
+	}
+}
@@ -0,0 +1,60 @@
+#include <futex.h>
+#include <mmu.h>
+#include <sched.h>
+
+TAILQ_HEAD(Futex_queue, Env);
+
+static struct Futex_queue futex_queues[FUTEX_NBUCKETS];
+
+static struct Futex_queue *futex_bucket(u_long key) {
+	return &futex_queues[((key >> 2) ^ (key >> PGSHIFT)) % FUTEX_NBUCKETS];
+}
+
+void futex_init(void) {
+	for (int i = 0; i < FUTEX_NBUCKETS; i++) {
+		TAILQ_INIT(&futex_queues[i]);
+	}
+}
+
+/* Overview:
+ *   Queue 'e' as a waiter on the word at physical address 'key'. 'e' must not be runnable.
+ */
+void futex_block(struct Env *e, u_long key) {
+	e->env_futex_key = key;
+	TAILQ_INSERT_TAIL(futex_bucket(key), e, env_futex_link);
+}
+
+/* Overview:
+ *   Remove 'e' from the waiters of its futex, if any.
+ */
+void futex_cancel(struct Env *e) {
+	if (e->env_futex_key == 0) {
+		return;
+	}
+	TAILQ_REMOVE(futex_bucket(e->env_futex_key), e, env_futex_link);
+	e->env_futex_key = 0;
+}
+
+/* Overview:
+ *   Make up to 'n' of the envs waiting on the word at physical address 'key' runnable, those
+ *   waiting longest first.
+ *
+ * Post-Condition:
+ *   Return the number of envs woken up.
+ */
+int futex_wake(u_long key, u_int n) {
+	struct Futex_queue *q = futex_bucket(key);
+	struct Env *e, *next;
+	u_int woken = 0;
+
+	for (e = TAILQ_FIRST(q); e != NULL && woken < n; e = next) {
+		next = TAILQ_NEXT(e, env_futex_link);
+		if (e->env_futex_key == key) {
+			futex_cancel(e);
+			e->env_status = ENV_RUNNABLE;
+			sched_insert(e, 0);
+			woken++;
+		}
+	}
+	return woken;
+}
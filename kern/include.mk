@@ -1,15 +1,16 @@
 lab-ge = $(shell [ "$$(echo $(lab)_ | cut -f1 -d_)" -ge $(1) ] && echo true)
 
-targets             := machine.o printk.o panic.o
+targets             := machine.o printk.o panic.o smp.o
 
 ifeq ($(call lab-ge,2), true)
-	targets     += pmap.o tlb_asm.o tlbex.o
+	targets     += pmap.o tlb_asm.o tlbex.o kmem.o rmap.o swap.o
 endif
 
 ifeq ($(call lab-ge,3), true)
-	targets     += env.o env_asm.o sched.o entry.o genex.o traps.o
+	targets     += env.o env_asm.o $(if $(filter cfs,$(MOS_SCHED)),sched_cfs.o,sched.o) kclock.o timer.o futex.o entry.o genex.o traps.o \
+		       $(if $(filter n,$(MOS_SYSSTAT)),,sysstat.o)
 endif
 
 ifeq ($(call lab-ge,4), true)
-	targets     += syscall_all.o
+	targets     += syscall_all.o ksm.o
 endif
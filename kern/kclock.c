@@ -0,0 +1,194 @@
+#include <asm/cp0regdef.h>
+#include <trap.h>
+#include <env.h>
+#include <kclock.h>
+#include <ksm.h>
+#include <printk.h>
+#include <sched.h>
+#include <sysstat.h>
+#include <timer.h>
+
+/*
+ * CP0_COUNT runs freely and is never reset. Instead of a periodic tick, CP0_COMPARE is
+ * programmed to the next deadline: the end of the current clock tick or the earliest wake-up of a
+ * sleeping env while an env runs, and the earliest wake-up only while the CPU is idle.
+ */
+static uint64_t kclock_high; // the high 32 bits of the time
+static u_int kclock_last;    // CP0_COUNT at the last 'kclock_now'
+static uint64_t kclock_tick_end;
+
+/*
+ * CPU time accounting: the time since 'acct_stamp' is charged to 'acct_env', as user time until
+ * it enters the kernel, and as kernel time from then on until we return to user mode, even if
+ * another env is scheduled in between. The time spent idle, and in the kernel after it, is not
+ * charged to anyone.
+ */
+static struct Env *acct_env;
+static uint64_t acct_stamp;
+
+extern void kclock_wait(void) __attribute__((noreturn));
+
+static inline u_int read_count(void) {
+	u_int count;
+
+	asm volatile("mfc0 %0, $9" : "=r"(count)); // CP0_COUNT
+	return count;
+}
+
+static inline void write_compare(u_int compare) {
+	asm volatile("mtc0 %0, $11" : : "r"(compare)); // CP0_COMPARE, also clears the interrupt
+}
+
+/* Overview:
+ *   Return the number of CP0_COUNT cycles since boot, extended to 64 bits.
+ *
+ * Pre-Condition:
+ *   Called at least once per wrap of CP0_COUNT, which 'KCLOCK_MAX_INTERVAL' guarantees.
+ */
+uint64_t kclock_now(void) {
+	u_int count = read_count();
+
+	if (count < kclock_last) {
+		kclock_high += 1ULL << 32;
+	}
+	kclock_last = count;
+	return kclock_high | count;
+}
+
+static void kclock_program(uint64_t deadline) {
+	uint64_t now = kclock_now();
+
+	if (deadline > now + KCLOCK_MAX_INTERVAL) {
+		deadline = now + KCLOCK_MAX_INTERVAL;
+	} else if (deadline < now + KCLOCK_MIN_INTERVAL) {
+		deadline = now + KCLOCK_MIN_INTERVAL;
+	}
+	write_compare((u_int)deadline);
+}
+
+/* Overview:
+ *   Start a new clock tick of 'TIMER_INTERVAL' cycles for the env about to run.
+ */
+void kclock_start_slice(void) {
+	kclock_tick_end = kclock_now() + TIMER_INTERVAL;
+}
+
+/* Overview:
+ *   Publish the time and 'curenv' in 'ukdata' for user space. The clock is bracketed by updates
+ *   of 'uk_seq', so a reader can tell it was interrupted in the middle of reading its two words.
+ */
+static void ukdata_update(void) {
+	ukdata->uk_seq++;
+	asm volatile("sync" ::: "memory");
+	ukdata->uk_clock = kclock_now();
+	ukdata->uk_curenv = curenv == NULL ? 0 : curenv->env_id;
+	asm volatile("sync" ::: "memory");
+	ukdata->uk_seq++;
+}
+
+/* Overview:
+ *   Program CP0_COMPARE to the end of the current tick, or an earlier wake-up.
+ *   Called right before returning to user mode.
+ */
+void kclock_reload(void) {
+	kclock_program(MIN(kclock_tick_end, timer_next()));
+	ukdata_update();
+	sysstat_end();
+}
+
+/* Overview:
+ *   Wait with interrupts enabled until the next sleeping env is due. The clock interrupt then
+ *   calls 'schedule' again on a fresh kernel stack.
+ *   Panic if no env is sleeping, as nothing could ever become runnable again.
+ */
+void kclock_idle(void) {
+	uint64_t next = timer_next();
+
+	if (next == KCLOCK_NEVER) {
+		panic("schedule: no runnable envs are available !\n");
+	}
+	kclock_program(next);
+	ukdata_update();
+	sysstat_end();
+	acct_forget(acct_env);
+	unlock_kernel();
+	kclock_wait();
+}
+
+/* Overview:
+ *   Count a tick in 'ukdata', and fold the number of runnable envs into the load average, an
+ *   exponential moving average where each new sample weighs '1 / (1 << UK_LOAD_DECAY)'.
+ */
+static void ukdata_tick(void) {
+	int delta = (int)(ukdata->uk_runnable << UK_LOAD_SHIFT) - (int)ukdata->uk_loadavg;
+
+	ukdata->uk_ticks++;
+	ukdata->uk_loadavg += delta >> UK_LOAD_DECAY;
+}
+
+/* Overview:
+ *   Handle the clock interrupt, taken in user mode or in the idle loop.
+ *   Wake up the sleeping envs which are due. At the end of a tick, also age the run queues, run
+ *   the KSM scanner and call 'schedule'. Otherwise a sleeping env was due first: only switch if
+ *   an env at a higher level became runnable (or if we were idle), and return to 'curenv' if not.
+ */
+void do_timer(void) {
+	timer_run(kclock_now());
+	if (curenv == NULL || kclock_now() >= kclock_tick_end) {
+		ukdata_tick();
+		sched_tick();
+#if !defined(LAB) || LAB >= 4
+		ksm_tick();
+#endif
+		schedule(0);
+	}
+	if (sched_need_preempt()) {
+		schedule(0);
+	}
+	kclock_reload();
+}
+
+static void acct_charge(int user) {
+	uint64_t now = kclock_now();
+
+	if (acct_env != NULL) {
+		if (user) {
+			acct_env->env_utime += now - acct_stamp;
+		} else {
+			acct_env->env_ktime += now - acct_stamp;
+		}
+	}
+	acct_stamp = now;
+}
+
+/* Overview:
+ *   Called on every exception, with the trapframe saved by 'exc_gen_entry'. An exception from
+ *   user mode ends the user time of 'acct_env'. Nested exceptions change nothing.
+ */
+void acct_enter(struct Trapframe *tf) {
+	if (tf->cp0_status & STATUS_UM) {
+		acct_charge(1);
+	}
+}
+
+/* Overview:
+ *   Called right before restoring 'tf'. Returning to user mode ends the kernel time of
+ *   'acct_env', and 'curenv' is charged from now on.
+ */
+void acct_exit(struct Trapframe *tf) {
+	if (tf->cp0_status & STATUS_UM) {
+		acct_charge(0);
+		acct_env = curenv;
+	}
+}
+
+/* Overview:
+ *   Charge the kernel time so far, and stop charging 'e', which goes away or is not the
+ *   reason we're in the kernel any more.
+ */
+void acct_forget(struct Env *e) {
+	if (e != NULL && e == acct_env) {
+		acct_charge(0);
+		acct_env = NULL;
+	}
+}
@@ -0,0 +1,290 @@
+#include <kmem.h>
+#include <mmu.h>
+#include <pmap.h>
+#include <printk.h>
+
+// Keep at most this many empty slabs per cache, release the others back to 'page_free_list'.
+#define KMEM_MAX_EMPTY 1
+
+// All caches that have been used at least once.
+struct Kmem_cache_list kmem_caches;
+
+// Size classes served by 'kmalloc'.
+static struct Kmem_cache kmalloc_caches[] = {
+    KMEM_CACHE_INITIALIZER("kmalloc-16", 16),	  KMEM_CACHE_INITIALIZER("kmalloc-32", 32),
+    KMEM_CACHE_INITIALIZER("kmalloc-64", 64),	  KMEM_CACHE_INITIALIZER("kmalloc-128", 128),
+    KMEM_CACHE_INITIALIZER("kmalloc-256", 256),	  KMEM_CACHE_INITIALIZER("kmalloc-512", 512),
+    KMEM_CACHE_INITIALIZER("kmalloc-1024", 1024), KMEM_CACHE_INITIALIZER("kmalloc-2048", 2048),
+};
+
+#define NKMALLOC (sizeof(kmalloc_caches) / sizeof(kmalloc_caches[0]))
+
+// Offset of the first object in a slab.
+#define SLAB_OBJ_OFFSET ROUND(sizeof(struct Slab), 8)
+
+static inline struct Slab *obj2slab(void *obj) {
+	return (struct Slab *)ROUNDDOWN(obj, PAGE_SIZE);
+}
+
+/* Overview:
+ *   Compute the geometry of 'cache' and register it in 'kmem_caches'.
+ *   This is done once, on the first allocation from the cache.
+ */
+static void kmem_cache_setup(struct Kmem_cache *cache) {
+	u_int size = ROUND(cache->kc_objsize < sizeof(void *) ? sizeof(void *) : cache->kc_objsize,
+			   sizeof(void *));
+
+	if (size > PAGE_SIZE - SLAB_OBJ_OFFSET) {
+		panic("kmem cache '%s': object size %d too large", cache->kc_name, size);
+	}
+	cache->kc_objsize = size;
+	cache->kc_objs_per_slab = (PAGE_SIZE - SLAB_OBJ_OFFSET) / size;
+	LIST_INIT(&cache->kc_partial);
+	LIST_INIT(&cache->kc_full);
+	LIST_INIT(&cache->kc_empty);
+	cache->kc_nempty = 0;
+
+	int i;
+	for (i = 0; i < KMEM_NAME_LEN - 1 && cache->kc_name[i]; i++) {
+		cache->kc_stat.ki_name[i] = cache->kc_name[i];
+	}
+	cache->kc_stat.ki_name[i] = '\0';
+	cache->kc_stat.ki_objsize = size;
+	cache->kc_stat.ki_objs_per_slab = cache->kc_objs_per_slab;
+
+	LIST_INSERT_HEAD(&kmem_caches, cache, kc_link);
+}
+
+// Initialize the page at 'slab' as an empty slab of 'cache', threading all its objects.
+static void kmem_slab_init(struct Kmem_cache *cache, struct Slab *slab, int is_static) {
+	void **obj;
+
+	slab->s_cache = cache;
+	slab->s_inuse = 0;
+	slab->s_static = is_static;
+	slab->s_free = NULL;
+	for (int i = cache->kc_objs_per_slab - 1; i >= 0; i--) {
+		obj = (void **)((u_long)slab + SLAB_OBJ_OFFSET + i * cache->kc_objsize);
+		*obj = slab->s_free;
+		slab->s_free = obj;
+	}
+	cache->kc_stat.ki_slabs++;
+}
+
+/* Overview:
+ *   Allocate a page for a new slab of 'cache'.
+ *
+ * Post-Condition:
+ *   Return the new slab, which is NOT on any list of 'cache' yet.
+ *   Return NULL if we're out of memory.
+ */
+static struct Slab *kmem_cache_grow(struct Kmem_cache *cache) {
+	struct Page *pp;
+	struct Slab *slab;
+
+	if (page_alloc(&pp) != 0) {
+		return NULL;
+	}
+	pp->pp_ref++;
+
+	slab = (struct Slab *)page2kva(pp);
+	kmem_slab_init(cache, slab, 0);
+	return slab;
+}
+
+/* Overview:
+ *   Give 'npages' pages of boot memory starting at 'mem' to 'cache' as static slabs.
+ *   Static slabs are never released, so the cache can serve allocations even when 'page_alloc'
+ *   cannot, e.g. before 'page_init' or while the free list is exhausted.
+ *
+ * Pre-Condition:
+ *   'mem' is page aligned and was allocated by 'alloc'.
+ */
+void kmem_cache_donate(struct Kmem_cache *cache, void *mem, u_int npages) {
+	struct Slab *slab;
+
+	if (cache->kc_objs_per_slab == 0) {
+		kmem_cache_setup(cache);
+	}
+	for (u_int i = 0; i < npages; i++) {
+		slab = (struct Slab *)((u_long)mem + i * PAGE_SIZE);
+		kmem_slab_init(cache, slab, 1);
+		LIST_INSERT_HEAD(&cache->kc_empty, slab, s_link);
+	}
+}
+
+/* Overview:
+ *   Allocate an object from 'cache'.
+ *   Partially used slabs are preferred, then cached empty slabs, and only then a new page is
+ *   taken from 'page_alloc'. The content of the returned object is undefined.
+ *
+ * Post-Condition:
+ *   Return the object on success, or NULL if we're out of memory.
+ */
+void *kmem_cache_alloc(struct Kmem_cache *cache) {
+	struct Slab *slab;
+	void **obj;
+
+	if (cache->kc_objs_per_slab == 0) {
+		kmem_cache_setup(cache);
+	}
+
+	if ((slab = LIST_FIRST(&cache->kc_partial)) != NULL) {
+		LIST_REMOVE(slab, s_link);
+	} else if ((slab = LIST_FIRST(&cache->kc_empty)) != NULL) {
+		LIST_REMOVE(slab, s_link);
+		if (!slab->s_static) {
+			cache->kc_nempty--;
+		}
+	} else if ((slab = kmem_cache_grow(cache)) == NULL) {
+		cache->kc_stat.ki_fails++;
+		return NULL;
+	}
+
+	obj = slab->s_free;
+	slab->s_free = *obj;
+	slab->s_inuse++;
+	if (slab->s_free == NULL) {
+		LIST_INSERT_HEAD(&cache->kc_full, slab, s_link);
+	} else {
+		LIST_INSERT_HEAD(&cache->kc_partial, slab, s_link);
+	}
+
+	cache->kc_stat.ki_inuse++;
+	cache->kc_stat.ki_allocs++;
+	return obj;
+}
+
+/* Overview:
+ *   Return 'obj' to 'cache'. If its slab becomes empty and the cache already holds enough empty
+ *   slabs, the page of the slab is released (static slabs are always kept).
+ *
+ * Pre-Condition:
+ *   'obj' was allocated from 'cache' and has not been freed since.
+ */
+void kmem_cache_free(struct Kmem_cache *cache, void *obj) {
+	struct Slab *slab = obj2slab(obj);
+
+	assert(slab->s_cache == cache && slab->s_inuse > 0);
+
+	LIST_REMOVE(slab, s_link);
+	*(void **)obj = slab->s_free;
+	slab->s_free = obj;
+	slab->s_inuse--;
+	cache->kc_stat.ki_inuse--;
+	cache->kc_stat.ki_frees++;
+
+	if (slab->s_inuse > 0) {
+		LIST_INSERT_HEAD(&cache->kc_partial, slab, s_link);
+	} else if (slab->s_static) {
+		LIST_INSERT_HEAD(&cache->kc_empty, slab, s_link);
+	} else if (cache->kc_nempty < KMEM_MAX_EMPTY) {
+		LIST_INSERT_HEAD(&cache->kc_empty, slab, s_link);
+		cache->kc_nempty++;
+	} else {
+		cache->kc_stat.ki_slabs--;
+		page_decref(pa2page(PADDR(slab)));
+	}
+}
+
+/* Overview:
+ *   Allocate 'size' bytes from the smallest fitting 'kmalloc' size class.
+ *
+ * Post-Condition:
+ *   Return NULL if 'size' is larger than the largest size class or we're out of memory.
+ */
+void *kmalloc(size_t size) {
+	for (int i = 0; i < NKMALLOC; i++) {
+		if (size <= kmalloc_caches[i].kc_objsize) {
+			return kmem_cache_alloc(&kmalloc_caches[i]);
+		}
+	}
+	return NULL;
+}
+
+/* Overview:
+ *   Free an object allocated by 'kmalloc'. Freeing NULL does nothing.
+ */
+void kfree(void *obj) {
+	if (obj != NULL) {
+		kmem_cache_free(obj2slab(obj)->s_cache, obj);
+	}
+}
+
+/* Overview:
+ *   Copy the statistics of at most 'n' caches into 'buf'.
+ *
+ * Post-Condition:
+ *   Return the total number of caches, which may be larger than 'n'.
+ */
+int kmem_info(struct Kmem_info *buf, u_int n) {
+	struct Kmem_cache *cache;
+	int count = 0;
+
+	LIST_FOREACH (cache, &kmem_caches, kc_link) {
+		if (count < n) {
+			buf[count] = cache->kc_stat;
+		}
+		count++;
+	}
+	return count;
+}
+
+void kmem_check(void) {
+	struct Kmem_cache cache = KMEM_CACHE_INITIALIZER("check", 99);
+	void *objs[100];
+	u_int nfree = 0, n;
+	struct Page *pp;
+	int i;
+
+	LIST_FOREACH (pp, &page_free_list, pp_link) {
+		nfree++;
+	}
+
+	// object size is rounded up to a multiple of the pointer size
+	objs[0] = kmem_cache_alloc(&cache);
+	assert(objs[0] != NULL);
+	assert(cache.kc_objsize == 100);
+	assert(cache.kc_objs_per_slab == (PAGE_SIZE - SLAB_OBJ_OFFSET) / 100);
+	assert(obj2slab(objs[0])->s_cache == &cache);
+
+	// fill more than two slabs, all objects must be distinct and inside their slab
+	for (i = 1; i < 100; i++) {
+		objs[i] = kmem_cache_alloc(&cache);
+		assert(objs[i] != NULL && objs[i] != objs[i - 1]);
+		assert((u_long)objs[i] - ROUNDDOWN(objs[i], PAGE_SIZE) >= sizeof(struct Slab));
+		memset(objs[i], i, 100);
+	}
+	assert(cache.kc_stat.ki_inuse == 100 && cache.kc_stat.ki_slabs == 3);
+
+	// a freed object is reused first
+	kmem_cache_free(&cache, objs[50]);
+	assert(kmem_cache_alloc(&cache) == objs[50]);
+
+	// freeing everything keeps one empty slab and releases the rest
+	for (i = 0; i < 100; i++) {
+		kmem_cache_free(&cache, objs[i]);
+	}
+	assert(cache.kc_stat.ki_inuse == 0 && cache.kc_stat.ki_slabs == KMEM_MAX_EMPTY);
+	assert(cache.kc_stat.ki_allocs == 101 && cache.kc_stat.ki_frees == 101);
+
+	// drop the cache on the stack together with its last slab, no page may be leaked
+	LIST_REMOVE(&cache, kc_link);
+	page_decref(pa2page(PADDR(LIST_FIRST(&cache.kc_empty))));
+	n = 0;
+	LIST_FOREACH (pp, &page_free_list, pp_link) {
+		n++;
+	}
+	assert(n == nfree);
+
+	// kmalloc picks the smallest class that fits
+	objs[0] = kmalloc(17);
+	assert(obj2slab(objs[0])->s_cache->kc_objsize == 32);
+	objs[1] = kmalloc(2048);
+	assert(obj2slab(objs[1])->s_cache->kc_objsize == 2048);
+	assert(objs[0] != objs[1] && kmalloc(PAGE_SIZE) == NULL);
+	kfree(objs[0]);
+	kfree(objs[1]);
+
+	printk("kmem_check() succeeded!\n");
+}
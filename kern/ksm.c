@@ -0,0 +1,272 @@
+#include <error.h>
+#include <kmem.h>
+#include <ksm.h>
+#include <mmu.h>
+#include <pmap.h>
+#include <printk.h>
+#include <rmap.h>
+
+struct Ksm_info ksm_stat = {.ks_rate = KSM_DEFAULT_RATE};
+
+/*
+ * An entry of the hash tables, keyed by the content hash of 'ki_page'.
+ * The stable table holds merged pages, which are only mapped read-only with 'PTE_COW', so their
+ * content cannot change. The unstable table holds private pages seen in the current pass; their
+ * content may change at any time, so it's compared again on every match and the table is emptied
+ * at the end of each pass.
+ */
+struct Ksm_item {
+	LIST_ENTRY(Ksm_item) ki_link;
+	struct Page *ki_page;
+	u_int ki_hash;
+};
+
+LIST_HEAD(Ksm_list, Ksm_item);
+
+static struct Kmem_cache ksm_item_cache = KMEM_CACHE_INITIALIZER("ksm", sizeof(struct Ksm_item));
+static struct Ksm_list ksm_stable[KSM_NBUCKETS];
+static struct Ksm_list ksm_unstable[KSM_NBUCKETS];
+static u_long ksm_cursor;	      // next page the scan looks at
+static u_int ksm_scanned, ksm_merged; // counters of the current pass
+static u_int ksm_zero_hash;
+
+// FNV-1a over the words of the page.
+static u_int ksm_hash(struct Page *pp) {
+	u_int *p = (u_int *)page2kva(pp);
+	u_int h = 2166136261u;
+
+	for (int i = 0; i < PAGE_SIZE / 4; i++) {
+		h = (h ^ p[i]) * 16777619u;
+	}
+	return h;
+}
+
+static int ksm_same(struct Page *a, struct Page *b) {
+	u_int *p = (u_int *)page2kva(a), *q = (u_int *)page2kva(b);
+
+	for (int i = 0; i < PAGE_SIZE / 4; i++) {
+		if (p[i] != q[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Overview:
+ *   Check whether 'pp' is a private page which may be merged: it's mapped exactly once, writable,
+ *   below 'UTOP', and is not shared memory ('PTE_LIBRARY'), whose writes must stay visible to
+ *   every env mapping it. Pages of page tables shared by 'fork' are private to none of their
+ *   users.
+ *
+ * Post-Condition:
+ *   Return 1 and set '*prm' and '*ppte' to the mapping if so, return 0 otherwise.
+ */
+static int ksm_candidate(struct Page *pp, struct Rmap **prm, Pte **ppte) {
+	struct Rmap *rm = LIST_FIRST(&pp->pp_rmap);
+
+	if (pp->pp_ref != 1 || pp->pp_ksm || rm == NULL || LIST_NEXT(rm, rm_link) != NULL ||
+	    RMAP_VA(rm) >= UTOP) {
+		return 0;
+	}
+	if (page_lookup(rm->rm_pgdir, RMAP_VA(rm), ppte) != pp ||
+	    (**ppte & (PTE_D | PTE_LIBRARY)) != PTE_D || pgtable_shared(rm->rm_pgdir, RMAP_VA(rm))) {
+		return 0;
+	}
+	*prm = rm;
+	return 1;
+}
+
+static int ksm_stable_fn(struct Page *pp, Pde *pgdir, u_int asid, u_long va, void *arg) {
+	Pte *pte;
+
+	if (va >= UTOP || page_lookup(pgdir, va, &pte) != pp ||
+	    (*pte & (PTE_D | PTE_COW | PTE_LIBRARY)) != PTE_COW) {
+		return 1;
+	}
+	++*(u_int *)arg;
+	return 0;
+}
+
+/* Overview:
+ *   Check whether 'pp' may still be used as a merged page: all its references are read-only
+ *   copy-on-write mappings below 'UTOP'.
+ *   A merged page may have been freed (and reused) since it entered the stable table, or made
+ *   writable again by a copy-on-write fault of its last user; both are caught here.
+ */
+static int ksm_stable_valid(struct Page *pp) {
+	u_int n = 0;
+
+	return rmap_foreach(pp, ksm_stable_fn, &n) == 0 && n > 0 && n == pp->pp_ref;
+}
+
+static void ksm_drop(struct Ksm_item *item, int stable) {
+	LIST_REMOVE(item, ki_link);
+	if (stable) {
+		item->ki_page->pp_ksm = 0;
+	}
+	kmem_cache_free(&ksm_item_cache, item);
+}
+
+/* Overview:
+ *   Map 'kpage', a merged page with the same content, in place of the private page mapped by
+ *   'rm' at '*pte'. The private page is freed.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_NO_MEM (and leave the mapping untouched) if we're out of memory.
+ */
+static int ksm_merge(struct Page *kpage, struct Rmap *rm, Pte *pte) {
+	u_int perm = (PTE_FLAGS(*pte) & ~PTE_D) | PTE_COW;
+
+	return page_insert(rm->rm_pgdir, RMAP_ASID(rm), kpage, RMAP_VA(rm), perm);
+}
+
+/* Overview:
+ *   Visit 'pp' in the current pass.
+ *   A page whose hash changed since the last pass is only remembered: its content is likely to
+ *   change again soon. Otherwise a zero-filled page is merged into the zero page, and any other
+ *   page into a stable page with the same content, or with a private page with the same content
+ *   seen earlier in this pass, which becomes a stable page. If neither exists, the page is added
+ *   to the unstable table.
+ */
+static void ksm_scan_page(struct Page *pp) {
+	struct Ksm_item *item, *next;
+	struct Ksm_list *bucket;
+	struct Rmap *rm, *urm;
+	struct Page *up;
+	Pte *pte, *upte;
+	u_int hash;
+
+	if (!ksm_candidate(pp, &rm, &pte)) {
+		return;
+	}
+	hash = ksm_hash(pp);
+	ksm_scanned++;
+	if (hash != pp->pp_checksum) {
+		pp->pp_checksum = hash;
+		return;
+	}
+
+	if (ksm_zero_hash == 0) {
+		ksm_zero_hash = ksm_hash(zero_page);
+	}
+	if (hash == ksm_zero_hash && zero_page->pp_ref < ZERO_PAGE_MAX_REF &&
+	    ksm_same(pp, zero_page)) {
+		if (ksm_merge(zero_page, rm, pte) == 0) {
+			ksm_merged++;
+		}
+		return;
+	}
+
+	bucket = &ksm_stable[hash % KSM_NBUCKETS];
+	for (item = LIST_FIRST(bucket); item != NULL; item = next) {
+		next = LIST_NEXT(item, ki_link);
+		if (!ksm_stable_valid(item->ki_page)) {
+			ksm_drop(item, 1);
+			continue;
+		}
+		if (item->ki_hash == hash && item->ki_page->pp_ref < KSM_MAX_SHARING &&
+		    ksm_same(item->ki_page, pp)) {
+			if (ksm_merge(item->ki_page, rm, pte) == 0) {
+				ksm_merged++;
+			}
+			return;
+		}
+	}
+
+	bucket = &ksm_unstable[hash % KSM_NBUCKETS];
+	for (item = LIST_FIRST(bucket); item != NULL; item = next) {
+		next = LIST_NEXT(item, ki_link);
+		if (item->ki_hash != hash) {
+			continue;
+		}
+		up = item->ki_page;
+		if (!ksm_candidate(up, &urm, &upte)) {
+			ksm_drop(item, 0);
+			continue;
+		}
+		if (!ksm_same(up, pp)) {
+			continue;
+		}
+
+		// Write-protect the earlier page and move it to the stable table.
+		page_account(urm->rm_pgdir, RMAP_ASID(urm), up, RMAP_VA(urm), *upte, -1);
+		*upte = (*upte & ~PTE_D) | PTE_COW;
+		page_account(urm->rm_pgdir, RMAP_ASID(urm), up, RMAP_VA(urm), *upte, 1);
+		tlb_invalidate(RMAP_ASID(urm), RMAP_VA(urm));
+		LIST_REMOVE(item, ki_link);
+		LIST_INSERT_HEAD(&ksm_stable[hash % KSM_NBUCKETS], item, ki_link);
+		up->pp_ksm = 1;
+		if (ksm_merge(up, rm, pte) == 0) {
+			ksm_merged++;
+		}
+		return;
+	}
+
+	if ((item = kmem_cache_alloc(&ksm_item_cache)) != NULL) {
+		item->ki_page = pp;
+		item->ki_hash = hash;
+		LIST_INSERT_HEAD(bucket, item, ki_link);
+	}
+}
+
+/* Overview:
+ *   Finish a pass: forget the unstable table, drop stale stable pages, and publish the statistics
+ *   of the pass in 'ksm_stat'.
+ */
+static void ksm_end_pass(void) {
+	struct Ksm_item *item, *next;
+	u_int shared = 0, sharing = 0;
+
+	for (int i = 0; i < KSM_NBUCKETS; i++) {
+		while ((item = LIST_FIRST(&ksm_unstable[i])) != NULL) {
+			ksm_drop(item, 0);
+		}
+		for (item = LIST_FIRST(&ksm_stable[i]); item != NULL; item = next) {
+			next = LIST_NEXT(item, ki_link);
+			if (!ksm_stable_valid(item->ki_page)) {
+				ksm_drop(item, 1);
+			} else if (item->ki_page->pp_ref > 1) {
+				shared++;
+				sharing += item->ki_page->pp_ref - 1;
+			}
+		}
+	}
+
+	ksm_stat.ks_runs++;
+	ksm_stat.ks_scanned = ksm_scanned;
+	ksm_stat.ks_merged = ksm_merged;
+	ksm_stat.ks_shared = shared;
+	ksm_stat.ks_sharing = sharing;
+	ksm_stat.ks_zero = zero_page->pp_ref - 1;
+	ksm_scanned = ksm_merged = 0;
+}
+
+/* Overview:
+ *   Examine the next 'n' physical pages, wrapping around (and finishing a pass) at the end of
+ *   'pages'.
+ *
+ * Pre-Condition:
+ *   Must only be called where no 'struct Page' or page table entry of a user page is held,
+ *   since any such page may be merged and freed.
+ */
+void ksm_scan(u_int n) {
+	while (n-- > 0) {
+		ksm_scan_page(&pages[ksm_cursor]);
+		if (++ksm_cursor == npage) {
+			ksm_cursor = 0;
+			ksm_end_pass();
+		}
+	}
+}
+
+/* Overview:
+ *   Called at the end of every clock tick, before 'schedule'. The interrupt is only taken in user
+ *   mode or in the idle loop, so no kernel path is interrupted.
+ */
+void ksm_tick(void) {
+	ksm_scan(ksm_stat.ks_rate);
+}
+
+void ksm_set_rate(u_int rate) {
+	ksm_stat.ks_rate = MIN(rate, KSM_MAX_RATE);
+}
@@ -1,4 +1,5 @@
 #include <env.h>
+#include <pmap.h>
 #include <print.h>
 #include <printk.h>
 
@@ -27,8 +28,6 @@ void _panic(const char *file, int line, const char *func, const char *fmt, ...)
 
 #if !defined(LAB) || LAB >= 3
 	extern struct Env envs[];
-	extern struct Env *curenv;
-	extern struct Pde *cur_pgdir;
 
 	if ((u_long)curenv >= KERNBASE) {
 		printk("curenv:    %x (id = 0x%x, off = %d)\n", curenv, curenv->env_id,
@@ -4,14 +4,15 @@
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
+#include <rmap.h>
+#include <swap.h>
 
 /* These variables are set by mips_detect_memory(ram_low_size); */
 static u_long memsize; /* Maximum physical address */
 u_long npage;	       /* Amount of memory(in pages) */
 
-Pde *cur_pgdir;
-
 struct Page *pages;
+struct Page *zero_page;
 static u_long freemem;
 
 struct Page_list page_free_list; /* Free list of physical pages */
@@ -81,6 +82,9 @@ void mips_vm_init() {
 	 * you should round up the memory size before map. */
 	pages = (struct Page *)alloc(npage * sizeof(struct Page), PAGE_SIZE, 1);
 	printk("to memory %x for struct Pages.\n", freemem);
+	rmap_init();
+	/* 'page_init' marks the zero page as used, which is its permanent reference. */
+	zero_page = pa2page(PADDR(alloc(PAGE_SIZE, PAGE_SIZE, 1)));
 	printk("pmap.c:\t mips vm init success\n");
 }
 
@@ -199,6 +203,7 @@ static int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte) {
 			*pgdir_entryp = page2pa(pp);
 			*pgdir_entryp = (*pgdir_entryp) | PTE_C_CACHEABLE | PTE_V;
 			pp->pp_ref++;
+			pp->pp_noshare = 0;
 		} else {
 			*ppte = 0;
 			return 0;
@@ -210,6 +215,77 @@ static int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte) {
 	return 0;
 }
 
+// The accounting of the env using each ASID, together with its page directory.
+static struct {
+	Pde *pgdir;
+	struct Env_mem *mem;
+} mem_owners[NASID];
+
+/* Overview:
+ *   Charge the mappings made in 'pgdir' with 'asid' to 'em' from now on, or stop charging them if
+ *   'em' is NULL.
+ */
+void page_account_bind(u_int asid, Pde *pgdir, struct Env_mem *em) {
+	mem_owners[asid].pgdir = pgdir;
+	mem_owners[asid].mem = em;
+}
+
+// Return the accounting of the env owning 'pgdir', or NULL for the kernel's own page tables.
+static struct Env_mem *mem_owner(Pde *pgdir, u_int asid) {
+	return mem_owners[asid].pgdir == pgdir ? mem_owners[asid].mem : NULL;
+}
+
+/* Overview:
+ *   Account a mapping of 'pp' at 'va' in 'pgdir' with page table entry 'pte', which is being
+ *   added ('n' is 1, after 'pp_ref' is incremented) or removed ('n' is -1, before 'pp_ref' is
+ *   decremented). Changing 'pte' in place is a removal followed by an addition.
+ *   A page becomes shared (or private) when its second reference comes (or goes), which also
+ *   changes the 'em_shared' of the env holding its other mapping.
+ */
+void page_account(Pde *pgdir, u_int asid, struct Page *pp, u_long va, Pte pte, int n) {
+	struct Env_mem *em;
+	struct Rmap *rm;
+
+	if (va >= UTOP) {
+		return;
+	}
+	if (pte & PTE_LIBRARY) {
+		pa2page(pgdir[PDX(va)])->pp_noshare += n;
+	}
+	if ((em = mem_owner(pgdir, asid)) != NULL) {
+		em->em_resident += n;
+		if (pte & PTE_COW) {
+			em->em_cow += n;
+		}
+		if (pp->pp_ref > 1) {
+			em->em_shared += n;
+		}
+	}
+	if (pp->pp_ref == 2) {
+		va = ROUNDDOWN(va, PAGE_SIZE);
+		LIST_FOREACH (rm, &pp->pp_rmap, rm_link) {
+			if (rm->rm_pgdir == pgdir && RMAP_VA(rm) == va) {
+				continue;
+			}
+			if (RMAP_VA(rm) < UTOP && (em = mem_owner(rm->rm_pgdir, RMAP_ASID(rm))) != NULL) {
+				em->em_shared += n;
+			}
+			break;
+		}
+	}
+}
+
+// Return the number of pages on 'page_free_list'.
+u_int page_free_count(void) {
+	struct Page *pp;
+	u_int n = 0;
+
+	LIST_FOREACH (pp, &page_free_list, pp_link) {
+		n++;
+	}
+	return n;
+}
+
 /* Overview:
  *   Map the physical page 'pp' at virtual address 'va'. The permission (the low 12 bits) of the
  *   page table entry should be set to 'perm | PTE_C_CACHEABLE | PTE_V'.
@@ -220,22 +296,30 @@ static int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte) {
  *
  * Hint:
  *   If there is already a page mapped at `va`, call page_remove() to release this mapping.
- *   The `pp_ref` should be incremented if the insertion succeeds.
+ *   The `pp_ref` should be incremented and a reverse mapping recorded if the insertion succeeds.
  */
 int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm) {
+	struct Env_mem *em;
+	int new_pt;
 	Pte *pte;
 
+	/* The swap bits are managed by the kernel and never come from 'perm'. */
+	perm &= ~(PTE_SWAP | PTE_REF);
+	/* The zero page is never writable, writes go through 'do_tlb_mod'. */
+	if (pp == zero_page) {
+		perm = (perm & ~PTE_D) | PTE_COW;
+	}
+	try(pgtable_unshare(pgdir, asid, va));
+
 	/* Step 1: Get corresponding page table entry. */
 	pgdir_walk(pgdir, va, 0, &pte);
 
-	if (pte && (*pte & PTE_V)) {
-		if (pa2page(*pte) != pp) {
-			page_remove(pgdir, asid, va);
-		} else {
-			tlb_invalidate(asid, va);
-			*pte = page2pa(pp) | perm | PTE_C_CACHEABLE | PTE_V;
-			return 0;
-		}
+	if (pte && (*pte & PTE_V) && pa2page(*pte) == pp) {
+		tlb_invalidate(asid, va);
+		page_account(pgdir, asid, pp, va, *pte, -1);
+		*pte = page2pa(pp) | perm | PTE_C_CACHEABLE | PTE_V;
+		page_account(pgdir, asid, pp, va, *pte, 1);
+		return 0;
 	}
 
 	/* Step 2: Flush TLB with 'tlb_invalidate'. */
@@ -245,13 +329,27 @@ int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm)
 	/* Step 3: Re-get or create the page table entry. */
 	/* If failed to create, return the error. */
 	/* Exercise 2.7: Your code here. (2/3) */
+	new_pt = !(pgdir[PDX(va)] & PTE_V);
 	try(pgdir_walk(pgdir, va, 1, &pte));
+	if (new_pt && (em = mem_owner(pgdir, asid)) != NULL) {
+		em->em_ptpages++;
+	}
+	if (pp != zero_page) {
+		try(rmap_add(pp, pgdir, asid, va));
+	}
+
+	/* The old mapping (or swapped out page, with its swap slot) is only dropped once nothing can
+	 * fail any more, so that an error leaves 'va' as it was. */
+	if (*pte & (PTE_V | PTE_SWAP)) {
+		page_remove(pgdir, asid, va);
+	}
 
 	/* Step 4: Insert the page to the page table entry with 'perm | PTE_C_CACHEABLE | PTE_V'
 	 * and increase its 'pp_ref'. */
 	/* Exercise 2.7: Your code here. (3/3) */
 	*pte = page2pa(pp) | perm | PTE_C_CACHEABLE | PTE_V;
 	pp->pp_ref++;
+	page_account(pgdir, asid, pp, va, *pte, 1);
 
 	return 0;
 }
@@ -300,17 +398,31 @@ void page_decref(struct Page *pp) {
 
 /* Lab 2 Key Code "page_remove" */
 // Overview:
-//   Unmap the physical page at virtual address 'va'.
+//   Unmap the physical page at virtual address 'va'. If the page is swapped out, release its
+//   swap slot instead.
 void page_remove(Pde *pgdir, u_int asid, u_long va) {
 	Pte *pte;
 
+	/* Callers which can fail unshare the page table themselves first. */
+	panic_on(pgtable_unshare(pgdir, asid, va));
+
 	/* Step 1: Get the page table entry, and check if the page table entry is valid. */
 	struct Page *pp = page_lookup(pgdir, va, &pte);
 	if (pp == NULL) {
+		pgdir_walk(pgdir, va, 0, &pte);
+		if (pte && (*pte & PTE_SWAP)) {
+			swap_free(*pte);
+			*pte = 0;
+			pa2page(pgdir[PDX(va)])->pp_noshare--;
+		}
 		return;
 	}
 
-	/* Step 2: Decrease reference count on 'pp'. */
+	/* Step 2: Drop the reverse mapping and decrease reference count on 'pp'. */
+	page_account(pgdir, asid, pp, va, *pte, -1);
+	if (pp != zero_page) {
+		rmap_remove(pp, pgdir, va);
+	}
 	page_decref(pp);
 
 	/* Step 3: Flush TLB. */
@@ -320,6 +432,311 @@ void page_remove(Pde *pgdir, u_int asid, u_long va) {
 }
 /* End of Key Code "page_remove" */
 
+/*
+ * Page tables shared by 'fork'.
+ * 'pgdir_fork' gives the child the page tables of its parent instead of copying their entries,
+ * and a table is only copied once an env using it changes one of its entries. A shared table:
+ *   - holds a reference ('pp_ref') for each page directory using it, and a reverse mapping
+ *     ('pp_rmap') to each of them, the one of its owner last;
+ *   - has the reverse mappings and the accounting of the pages it maps in the name of its owner
+ *     only ('pgdir_account_shared' adds them to the statistics of the others);
+ *   - is read-only: the TLB refill drops 'PTE_D' from its entries, so that the first write
+ *     through it faults and gets the writer its own copy (see 'pgtable_unshare');
+ *   - maps neither shared memory nor swapped out pages ('pp_noshare' is 0), and its pages are
+ *     left alone by the swapper and the KSM scanner.
+ */
+
+// Return the page table mapping 'va' in 'pgdir', which must be valid.
+static struct Page *pgtable_page(Pde *pgdir, u_long va) {
+	return pa2page(pgdir[PDX(va)]);
+}
+
+// Return whether the page table mapping 'va' in 'pgdir' is shared with other page directories.
+int pgtable_shared(Pde *pgdir, u_long va) {
+	return va < UTOP && (pgdir[PDX(va)] & PTE_V) && pgtable_page(pgdir, va)->pp_ref > 1;
+}
+
+// Return the reverse mapping of the owner of the shared page table 'ptp'.
+static struct Rmap *pgtable_owner(struct Page *ptp) {
+	struct Rmap *rm = LIST_FIRST(&ptp->pp_rmap);
+
+	while (LIST_NEXT(rm, rm_link) != NULL) {
+		rm = LIST_NEXT(rm, rm_link);
+	}
+	return rm;
+}
+
+// Return the reverse mapping of 'pgdir' to the shared page table 'ptp'.
+static struct Rmap *pgtable_user(struct Page *ptp, Pde *pgdir) {
+	struct Rmap *rm;
+
+	LIST_FOREACH (rm, &ptp->pp_rmap, rm_link) {
+		if (rm->rm_pgdir == pgdir) {
+			return rm;
+		}
+	}
+	panic("page table %x is not shared with %x", page2pa(ptp), pgdir);
+}
+
+/* Overview:
+ *   Make 'to', a user of the shared page table 'ptp', its owner in place of 'from': the reverse
+ *   mappings and the accounting of the pages it maps move over to 'to'.
+ */
+static void pgtable_give(struct Page *ptp, struct Rmap *from, struct Rmap *to) {
+	Pte *pt = (Pte *)page2kva(ptp);
+	struct Page *pp;
+	u_long va;
+
+	for (u_int i = 0; i <= PTX(~0); i++) {
+		if (!(pt[i] & PTE_V)) {
+			continue;
+		}
+		va = RMAP_VA(from) + (i << PGSHIFT);
+		pp = pa2page(pt[i]);
+		page_account(from->rm_pgdir, RMAP_ASID(from), pp, va, pt[i], -1);
+		if (pp != zero_page) {
+			rmap_move(pp, from->rm_pgdir, va, to->rm_pgdir, RMAP_ASID(to));
+		}
+		page_account(to->rm_pgdir, RMAP_ASID(to), pp, va, pt[i], 1);
+	}
+	LIST_REMOVE(to, rm_link);
+	LIST_INSERT_AFTER(from, to, rm_link);
+}
+
+// Drop the user 'rm' of the shared page table 'ptp', which is private again if one user is left.
+static void pgtable_drop(struct Page *ptp, struct Rmap *rm) {
+	struct Rmap *last;
+
+	if (rm == pgtable_owner(ptp)) {
+		pgtable_give(ptp, rm, LIST_FIRST(&ptp->pp_rmap));
+	}
+	rmap_remove(ptp, rm->rm_pgdir, RMAP_VA(rm));
+	if (--ptp->pp_ref == 1) {
+		last = LIST_FIRST(&ptp->pp_rmap);
+		rmap_remove(ptp, last->rm_pgdir, RMAP_VA(last));
+	}
+}
+
+/* Overview:
+ *   Share the page table of 'src' mapping 'va' with 'dst', unless it maps shared memory or
+ *   swapped out pages. The TLB entries of 'src' for it, which may be writable, are dropped by the
+ *   TLB batch of 'pgdir_fork'.
+ *
+ * Post-Condition:
+ *   Return 1 if the table is shared, 0 if it cannot be, or -E_NO_MEM if we're out of memory.
+ */
+static int pgtable_share(Pde *src, u_int srcasid, Pde *dst, u_int dstasid, u_long va) {
+	struct Page *ptp = pgtable_page(src, va);
+	struct Env_mem *em;
+
+	if (ptp->pp_noshare != 0) {
+		return 0;
+	}
+	if (ptp->pp_ref == 1) {
+		try(rmap_add(ptp, src, srcasid, va));
+	}
+	if (rmap_add(ptp, dst, dstasid, va) != 0) {
+		if (ptp->pp_ref == 1) {
+			rmap_remove(ptp, src, va);
+		}
+		return -E_NO_MEM;
+	}
+	ptp->pp_ref++;
+	dst[PDX(va)] = src[PDX(va)];
+	if ((em = mem_owner(dst, dstasid)) != NULL) {
+		em->em_ptpages++;
+	}
+	tlb_invalidate(srcasid, va);
+	tlb_invalidate(srcasid, va + PDMAP - PAGE_SIZE);
+	return 1;
+}
+
+/* Overview:
+ *   Give 'pgdir' a private copy of the page table mapping 'va' if it's shared, before one of its
+ *   entries is changed. The pages it maps are then mapped by two tables, so writable ones become
+ *   copy-on-write in both, as if 'pgdir_fork' had copied the table in the first place.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_NO_MEM (and leave the table shared) if we're out of memory.
+ */
+int pgtable_unshare(Pde *pgdir, u_int asid, u_long va) {
+	struct Page *ptp, *np, *pp;
+	struct Rmap *me, *owner;
+	u_long base = ROUNDDOWN(va, PDMAP);
+	Pte *pt, *npt;
+	u_int i;
+
+	if (!pgtable_shared(pgdir, va)) {
+		return 0;
+	}
+	ptp = pgtable_page(pgdir, va);
+	me = pgtable_user(ptp, pgdir);
+	try(page_alloc(&np));
+	if ((owner = pgtable_owner(ptp)) == me) {
+		owner = LIST_FIRST(&ptp->pp_rmap);
+		pgtable_give(ptp, me, owner);
+	}
+
+	pt = (Pte *)page2kva(ptp);
+	npt = (Pte *)page2kva(np);
+	for (i = 0; i <= PTX(~0); i++) {
+		if (!(pt[i] & PTE_V)) {
+			continue;
+		}
+		va = base + (i << PGSHIFT);
+		pp = pa2page(pt[i]);
+		if (pp != zero_page && rmap_add(pp, pgdir, asid, va) != 0) {
+			break;
+		}
+		if (pt[i] & PTE_D) {
+			page_account(owner->rm_pgdir, RMAP_ASID(owner), pp, va, pt[i], -1);
+			pt[i] = (pt[i] & ~PTE_D) | PTE_COW;
+			page_account(owner->rm_pgdir, RMAP_ASID(owner), pp, va, pt[i], 1);
+		}
+		npt[i] = pt[i];
+		pp->pp_ref++;
+		page_account(pgdir, asid, pp, va, npt[i], 1);
+	}
+	if (i <= PTX(~0)) {
+		// Out of memory: drop the entries copied so far.
+		while (i-- > 0) {
+			if (!(npt[i] & PTE_V)) {
+				continue;
+			}
+			va = base + (i << PGSHIFT);
+			pp = pa2page(npt[i]);
+			page_account(pgdir, asid, pp, va, npt[i], -1);
+			if (pp != zero_page) {
+				rmap_remove(pp, pgdir, va);
+			}
+			pp->pp_ref--;
+		}
+		page_free(np);
+		return -E_NO_MEM;
+	}
+
+	np->pp_ref = 1;
+	np->pp_noshare = 0;
+	pgtable_drop(ptp, me);
+	pgdir[PDX(base)] = page2pa(np) | PTE_C_CACHEABLE | PTE_V;
+	tlb_invalidate(asid, UVPT + (PDX(base) << PGSHIFT));
+	return 0;
+}
+
+/* Overview:
+ *   Stop using the page table mapping 'va' in 'pgdir' if it's shared, for 'env_free': its
+ *   entries stay for the other users. If 'pgdir' owns it, another user takes it over.
+ *
+ * Post-Condition:
+ *   Return 1 if the table was shared (the caller then just clears its page directory entry),
+ *   0 otherwise.
+ */
+int pgtable_leave(Pde *pgdir, u_long va) {
+	struct Page *ptp;
+
+	if (!pgtable_shared(pgdir, va)) {
+		return 0;
+	}
+	ptp = pgtable_page(pgdir, va);
+	pgtable_drop(ptp, pgtable_user(ptp, pgdir));
+	return 1;
+}
+
+/* Overview:
+ *   Add to 'em', the accounting of 'pgdir', what the page tables it shares with other page
+ *   directories would add had 'fork' copied them: their pages count as shared, and writable
+ *   ones as copy-on-write, for every user. 'page_account' only charges them to the owner of the
+ *   table, as they were before the fork.
+ */
+void pgdir_account_shared(Pde *pgdir, struct Env_mem *em) {
+	struct Page *ptp;
+	Pte *pt;
+	int owned;
+
+	for (u_long va = 0; va < UTOP; va += PDMAP) {
+		if (!pgtable_shared(pgdir, va)) {
+			continue;
+		}
+		ptp = pgtable_page(pgdir, va);
+		owned = pgtable_owner(ptp)->rm_pgdir == pgdir;
+		pt = (Pte *)page2kva(ptp);
+		for (u_int i = 0; i <= PTX(~0); i++) {
+			if (!(pt[i] & PTE_V)) {
+				continue;
+			}
+			if (owned) {
+				em->em_shared += pa2page(pt[i])->pp_ref == 1;
+				em->em_cow += (pt[i] & PTE_D) != 0;
+			} else {
+				em->em_resident++;
+				em->em_shared++;
+				em->em_cow += (pt[i] & (PTE_D | PTE_COW)) != 0;
+			}
+		}
+	}
+}
+
+/* Overview:
+ *   Map the user pages of 'src' below 'limit' at the same addresses in 'dst', for 'fork'.
+ *   Page tables entirely below 'limit' are shared with 'dst' (see 'pgtable_share') when they can
+ *   be, and copied when either env changes them. The entries of the other tables are copied
+ *   here: writable pages are mapped copy-on-write (without 'PTE_D') in both, and so are pages
+ *   which are copy-on-write already; shared memory ('PTE_LIBRARY') and read-only pages keep their
+ *   permissions. Swapped out pages are read back first.
+ *
+ * Pre-Condition:
+ *   'dst' maps nothing below 'limit'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_NO_MEM if we're out of memory (then only part of the pages are
+ *   mapped in 'dst').
+ */
+int pgdir_fork(Pde *src, u_int srcasid, Pde *dst, u_int dstasid, u_long limit) {
+	struct Page *pp;
+	Pte *pte;
+	u_int perm;
+	u_long va;
+	int r = 0;
+
+	tlb_batch_begin(srcasid);
+	for (va = 0; va < limit && r == 0; va += PAGE_SIZE) {
+		if (!(src[PDX(va)] & PTE_V)) {
+			va = ROUNDDOWN(va, PDMAP) + PDMAP - PAGE_SIZE;
+			continue;
+		}
+		if (PTX(va) == 0 && limit - va >= PDMAP) {
+			if ((r = pgtable_share(src, srcasid, dst, dstasid, va)) < 0) {
+				break;
+			}
+			if (r == 1) {
+				r = 0;
+				va += PDMAP - PAGE_SIZE;
+				continue;
+			}
+		}
+		pte = (Pte *)KADDR(PTE_ADDR(src[PDX(va)])) + PTX(va);
+		if ((*pte & PTE_SWAP) && (r = swap_in(src, srcasid, va)) < 0) {
+			break;
+		}
+		if (!(*pte & PTE_V)) {
+			r = 0;
+			continue;
+		}
+		pp = pa2page(*pte);
+		perm = PTE_FLAGS(*pte);
+		if ((perm & (PTE_D | PTE_COW)) && !(perm & PTE_LIBRARY)) {
+			perm = (perm & ~PTE_D) | PTE_COW;
+			if ((r = page_insert(dst, dstasid, pp, va, perm)) == 0 && (*pte & PTE_D)) {
+				r = page_insert(src, srcasid, pp, va, perm);
+			}
+		} else {
+			r = page_insert(dst, dstasid, pp, va, perm);
+		}
+	}
+	tlb_batch_end();
+	return r < 0 ? r : 0;
+}
+
 void physical_memory_manage_check(void) {
 	struct Page *pp, *pp0, *pp1, *pp2;
 	struct Page_list fl;
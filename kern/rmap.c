@@ -0,0 +1,207 @@
+#include <error.h>
+#include <kmem.h>
+#include <rmap.h>
+
+static struct Kmem_cache rmap_cache = KMEM_CACHE_INITIALIZER("rmap", sizeof(struct Rmap));
+
+/* Overview:
+ *   Reserve boot memory for the reverse mappings created before (and during) the checks of
+ *   'page_alloc', e.g. the mappings of 'pages' and 'envs' in 'base_pgdir'.
+ *
+ * Pre-Condition:
+ *   Called from 'mips_vm_init', before 'page_init'.
+ */
+void rmap_init(void) {
+	void *mem = alloc(RMAP_RESERVE_PAGES * PAGE_SIZE, PAGE_SIZE, 0);
+	kmem_cache_donate(&rmap_cache, mem, RMAP_RESERVE_PAGES);
+}
+
+/* Overview:
+ *   Record that 'pgdir' maps 'pp' at 'va' with ASID 'asid'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_NO_MEM if no reverse mapping could be allocated.
+ */
+int rmap_add(struct Page *pp, Pde *pgdir, u_int asid, u_long va) {
+	struct Rmap *rm = kmem_cache_alloc(&rmap_cache);
+
+	if (rm == NULL) {
+		return -E_NO_MEM;
+	}
+	rm->rm_pgdir = pgdir;
+	rm->rm_vaasid = ROUNDDOWN(va, PAGE_SIZE) | asid;
+	LIST_INSERT_HEAD(&pp->pp_rmap, rm, rm_link);
+	return 0;
+}
+
+/* Overview:
+ *   Forget the mapping of 'pp' at 'va' in 'pgdir'.
+ *
+ * Pre-Condition:
+ *   The mapping was recorded by 'rmap_add'.
+ */
+void rmap_remove(struct Page *pp, Pde *pgdir, u_long va) {
+	struct Rmap *rm;
+
+	va = ROUNDDOWN(va, PAGE_SIZE);
+	LIST_FOREACH (rm, &pp->pp_rmap, rm_link) {
+		if (rm->rm_pgdir == pgdir && RMAP_VA(rm) == va) {
+			LIST_REMOVE(rm, rm_link);
+			kmem_cache_free(&rmap_cache, rm);
+			return;
+		}
+	}
+	panic("rmap_remove: page %x is not mapped at %x in %x", page2pa(pp), va, pgdir);
+}
+
+/* Overview:
+ *   Record that the mapping of 'pp' at 'va' in 'pgdir' is now made by 'npgdir' with ASID
+ *   'nasid', which took over the page table holding it (see 'pgtable_leave').
+ *
+ * Pre-Condition:
+ *   The mapping was recorded by 'rmap_add'.
+ */
+void rmap_move(struct Page *pp, Pde *pgdir, u_long va, Pde *npgdir, u_int nasid) {
+	struct Rmap *rm;
+
+	va = ROUNDDOWN(va, PAGE_SIZE);
+	LIST_FOREACH (rm, &pp->pp_rmap, rm_link) {
+		if (rm->rm_pgdir == pgdir && RMAP_VA(rm) == va) {
+			rm->rm_pgdir = npgdir;
+			rm->rm_vaasid = va | nasid;
+			return;
+		}
+	}
+	panic("rmap_move: page %x is not mapped at %x in %x", page2pa(pp), va, pgdir);
+}
+
+/* Overview:
+ *   Call 'fn' for every mapping of 'pp', see 'rmap_fn_t'.
+ *
+ * Post-Condition:
+ *   Return the first non-zero value returned by 'fn', or 0 if all calls returned 0.
+ */
+int rmap_foreach(struct Page *pp, rmap_fn_t fn, void *arg) {
+	struct Rmap *rm, *next;
+	int r;
+
+	for (rm = LIST_FIRST(&pp->pp_rmap); rm != NULL; rm = next) {
+		next = LIST_NEXT(rm, rm_link);
+		if ((r = fn(pp, rm->rm_pgdir, RMAP_ASID(rm), RMAP_VA(rm), arg)) != 0) {
+			return r;
+		}
+	}
+	return 0;
+}
+
+// Return the number of page table entries mapping 'pp'.
+int page_mapcount(struct Page *pp) {
+	struct Rmap *rm;
+	int n = 0;
+
+	LIST_FOREACH (rm, &pp->pp_rmap, rm_link) {
+		n++;
+	}
+	return n;
+}
+
+/* Overview:
+ *   Remove all mappings of 'pp' with 'page_remove'. The page is freed if no other reference
+ *   to it remains.
+ *
+ * Post-Condition:
+ *   Return the number of mappings removed.
+ */
+int page_unmap_all(struct Page *pp) {
+	struct Rmap *rm;
+	int n = 0;
+
+	while ((rm = LIST_FIRST(&pp->pp_rmap)) != NULL) {
+		page_remove(rm->rm_pgdir, RMAP_ASID(rm), RMAP_VA(rm));
+		n++;
+	}
+	return n;
+}
+
+/* Overview:
+ *   Print the number of reverse mappings and the memory they cost: one list head in every
+ *   'struct Page' plus the slabs of 'rmap_cache'.
+ */
+void rmap_report(void) {
+	struct Kmem_info *ki = &rmap_cache.kc_stat;
+	u_int mapped = 0, shared = 0, longest = 0, heads, n;
+
+	for (u_long i = 0; i < npage; i++) {
+		n = page_mapcount(&pages[i]);
+		if (n > 0) {
+			mapped++;
+		}
+		if (n > 1) {
+			shared++;
+		}
+		if (n > longest) {
+			longest = n;
+		}
+	}
+	heads = npage * sizeof(struct Rmap_list);
+
+	printk("rmap: %d mappings of %d pages (%d shared), longest chain %d\n", ki->ki_inuse, mapped,
+	       shared, longest);
+	printk("rmap: overhead %d KiB (list heads %d B, %d slabs of %d B entries)\n",
+	       (heads + ki->ki_slabs * PAGE_SIZE) / 1024, heads, ki->ki_slabs, ki->ki_objsize);
+}
+
+static int rmap_check_fn(struct Page *pp, Pde *pgdir, u_int asid, u_long va, void *arg) {
+	assert(pgdir == arg);
+	assert(va2pa(pgdir, va) == page2pa(pp));
+	assert(asid == (va == PDMAP ? 2 : 1));
+	return 0;
+}
+
+static int rmap_stop_fn(struct Page *pp, Pde *pgdir, u_int asid, u_long va, void *arg) {
+	return ++*(int *)arg == 2 ? -1 : 0;
+}
+
+void rmap_check(void) {
+	struct Page *pp, *pp2, *ptp;
+	Pde *pgdir;
+	int count = 0;
+
+	assert(page_alloc(&ptp) == 0);
+	ptp->pp_ref++;
+	pgdir = (Pde *)page2kva(ptp);
+	assert(page_alloc(&pp) == 0);
+	assert(page_alloc(&pp2) == 0);
+
+	// three mappings through two page tables
+	assert(page_insert(pgdir, 1, pp, 0, 0) == 0);
+	assert(page_insert(pgdir, 1, pp, PAGE_SIZE, PTE_D) == 0);
+	assert(page_insert(pgdir, 2, pp, PDMAP, 0) == 0);
+	assert(pp->pp_ref == 3 && page_mapcount(pp) == 3);
+
+	// changing the permission of a mapping doesn't add a reverse mapping
+	assert(page_insert(pgdir, 1, pp, PAGE_SIZE, 0) == 0);
+	assert(pp->pp_ref == 3 && page_mapcount(pp) == 3);
+
+	// every reverse mapping leads back to a page table entry of 'pp'
+	assert(rmap_foreach(pp, rmap_check_fn, pgdir) == 0);
+	assert(rmap_foreach(pp, rmap_stop_fn, &count) == -1 && count == 2);
+
+	// replacing a mapping moves the reverse mapping to the new page
+	assert(page_insert(pgdir, 1, pp2, 0, 0) == 0);
+	assert(page_mapcount(pp) == 2 && page_mapcount(pp2) == 1);
+	page_remove(pgdir, 1, 0);
+	assert(pp2->pp_ref == 0 && page_mapcount(pp2) == 0);
+
+	// unmap everything, which frees 'pp'
+	assert(page_unmap_all(pp) == 2);
+	assert(pp->pp_ref == 0 && page_mapcount(pp) == 0);
+	assert(va2pa(pgdir, PAGE_SIZE) == ~0 && va2pa(pgdir, PDMAP) == ~0);
+
+	page_decref(pa2page(PTE_ADDR(pgdir[0])));
+	page_decref(pa2page(PTE_ADDR(pgdir[1])));
+	page_decref(ptp);
+
+	rmap_report();
+	printk("rmap_check() succeeded!\n");
+}
@@ -1,53 +1,175 @@
 #include <env.h>
+#include <kclock.h>
 #include <pmap.h>
 #include <printk.h>
+#include <sched.h>
+
+// Invariant: 'env' is in 'sched_queues[env->env_qlevel]' iff. 'env->env_status' is 'RUNNABLE'.
+// The running env stays at the head of its queue until it's switched out.
+static struct Env_sched_list sched_queues[SCHED_NLEVELS];
+static u_int sched_bitmap; // bit 'i' is set iff. 'sched_queues[i]' is not empty
+static u_int sched_ticks;
+
+void sched_init(void) {
+	for (int i = 0; i < SCHED_NLEVELS; i++) {
+		TAILQ_INIT(&sched_queues[i]);
+	}
+	sched_bitmap = 0;
+}
+
+// Return the highest non-empty level, or -1 if no env is runnable.
+static int sched_highest(void) {
+	return sched_bitmap == 0 ? -1 : 31 - __builtin_clz(sched_bitmap);
+}
+
+/* Overview:
+ *   Insert 'e' at the head (if 'head' is set) or the tail of the queue of its current level.
+ */
+void sched_insert(struct Env *e, int head) {
+	struct Env_sched_list *q = &sched_queues[e->env_qlevel];
+
+	if (head) {
+		TAILQ_INSERT_HEAD(q, e, env_sched_link);
+	} else {
+		TAILQ_INSERT_TAIL(q, e, env_sched_link);
+	}
+	sched_bitmap |= 1 << e->env_qlevel;
+	ukdata->uk_runnable++;
+}
+
+/* Overview:
+ *   Remove 'e' from its queue, and drop it back to its base level. Does nothing if 'e' is not
+ *   queued.
+ */
+void sched_remove(struct Env *e) {
+	struct Env_sched_list *q = &sched_queues[e->env_qlevel];
+
+	if (e->env_sched_link.tqe_prev == NULL) {
+		return;
+	}
+	TAILQ_REMOVE(q, e, env_sched_link);
+	e->env_sched_link.tqe_prev = NULL;
+	ukdata->uk_runnable--;
+	if (TAILQ_EMPTY(q)) {
+		sched_bitmap &= ~(1 << e->env_qlevel);
+	}
+	e->env_qlevel = e->env_level;
+}
 
 /* Overview:
- *   Implement a round-robin scheduling to select a runnable env and schedule it using 'env_run'.
+ *   Set the base level of 'e' to 'level' and move it to the tail of that queue if it's queued.
+ *
+ * Pre-Condition:
+ *   'level' is less than 'SCHED_NLEVELS'.
+ */
+void sched_set_level(struct Env *e, u_int level) {
+	int queued = e->env_sched_link.tqe_prev != NULL;
+
+	sched_remove(e);
+	e->env_level = e->env_qlevel = level;
+	if (queued) {
+		sched_insert(e, 0);
+	}
+}
+
+/* Overview:
+ *   Called at the end of every clock tick, before 'schedule'.
+ *   Every 'SCHED_AGING_TICKS' ticks, move the env waiting at the head of each non-empty level
+ *   below the highest one up one level. Levels are visited from the top down, so no env moves
+ *   more than once.
+ */
+void sched_tick(void) {
+	struct Env *e;
+
+	if (++sched_ticks % SCHED_AGING_TICKS != 0) {
+		return;
+	}
+	for (int i = sched_highest() - 1; i >= 0; i--) {
+		e = TAILQ_FIRST(&sched_queues[i]);
+		if (e == curenv) {
+			e = TAILQ_NEXT(e, env_sched_link);
+		}
+		if (e == NULL) {
+			continue;
+		}
+		sched_remove(e);
+		e->env_qlevel = i + 1;
+		sched_insert(e, 0);
+	}
+}
+
+/* Overview:
+ *   Return whether an env at a higher level than 'curenv' is runnable.
+ */
+int sched_need_preempt(void) {
+	return curenv != NULL && sched_highest() > (int)curenv->env_qlevel;
+}
+
+/* Overview:
+ *   Select the next env from the highest non-empty level, round-robin within a level, and
+ *   schedule it using 'env_run'.
  *
  * Post-Condition:
  *   If 'yield' is set (non-zero), 'curenv' should not be scheduled again unless it is the only
- *   runnable env.
+ *   runnable env at the highest non-empty level.
  *
  * Hints:
  *   1. The variable 'count' used for counting slices should be defined as 'static'.
- *   2. Use variable 'env_sched_list', which contains and only contains all runnable envs.
- *   3. You shouldn't use any 'return' statement because this function is 'noreturn'.
+ *   2. You shouldn't use any 'return' statement because this function is 'noreturn'.
  */
 void schedule(int yield) {
 	static int count = 0; // remaining time slices of current env
 	struct Env *e = curenv;
+	int level;
 
 	/* We always decrease the 'count' by 1.
 	 *
 	 * If 'yield' is set, or 'count' has been decreased to 0, or 'e' (previous 'curenv') is
-	 * 'NULL', or 'e' is not runnable, then we pick up a new env from 'env_sched_list' (list of
-	 * all runnable envs), set 'count' to its priority, and schedule it with 'env_run'. **Panic
-	 * if that list is empty**.
-	 *
-	 * (Note that if 'e' is still a runnable env, we should move it to the tail of
-	 * 'env_sched_list' before picking up another env from its head, or we will schedule the
-	 * head env repeatedly.)
+	 * 'NULL', or 'e' is not runnable, or a higher level than that of 'e' is not empty, then we
+	 * move 'e' (if still runnable) back to the tail of its base level, pick up the env at the
+	 * head of the highest non-empty level, set 'count' to its priority, and schedule it with
+	 * 'env_run'. If no env is runnable, we save the context of 'e' and wait in the idle loop
+	 * for a timer to make one runnable.
 	 *
 	 * Otherwise, we simply schedule 'e' again.
 	 *
-	 * You may want to use macros below:
-	 *   'TAILQ_FIRST', 'TAILQ_REMOVE', 'TAILQ_INSERT_TAIL'
+	 * Either way, a new clock tick starts.
 	 */
-	/* Exercise 3.12: Your code here. */
-	if (yield || count == 0 || e == NULL || e->env_status != ENV_RUNNABLE) {
-		if (e != NULL) {
-			TAILQ_REMOVE(&env_sched_list, e, env_sched_link);
-			if (e->env_status == ENV_RUNNABLE) {
-				TAILQ_INSERT_TAIL(&env_sched_list, e, env_sched_link);
-			}
+	if (yield || count <= 0 || e == NULL || e->env_status != ENV_RUNNABLE ||
+	    sched_highest() > (int)e->env_qlevel) {
+		if (e != NULL && e->env_status == ENV_RUNNABLE) {
+			sched_remove(e);
+			sched_insert(e, 0);
 		}
-		e = TAILQ_FIRST(&env_sched_list);
-		if (e == NULL) {
-			panic("schedule: no runnable envs are available !\n");
+		level = sched_highest();
+		if (level < 0) {
+			if (curenv != NULL) {
+				curenv->env_tf = *cur_tf;
+				curenv = NULL;
+			}
+			kclock_idle();
 		}
+		e = TAILQ_FIRST(&sched_queues[level]);
 		count = e->env_pri;
 	}
 	count--;
+	kclock_start_slice();
+	env_run(e);
+}
+
+/* Overview:
+ *   Switch to the runnable env 'e' for the rest of the slice of 'curenv', which is moved to the
+ *   tail of its queue if still runnable. Used to pass the CPU along with an IPC message instead
+ *   of waiting behind the other runnable envs.
+ *   If an env at a higher level than 'e' is runnable, this is 'schedule(1)' instead.
+ */
+void sched_handoff(struct Env *e) {
+	if (e->env_sched_link.tqe_prev == NULL || sched_highest() > (int)e->env_qlevel) {
+		schedule(1);
+	}
+	if (curenv != NULL && curenv->env_status == ENV_RUNNABLE) {
+		sched_remove(curenv);
+		sched_insert(curenv, 0);
+	}
 	env_run(e);
 }
@@ -0,0 +1,223 @@
+#include <env.h>
+#include <kclock.h>
+#include <pmap.h>
+#include <printk.h>
+#include <sched.h>
+
+/*
+ * A fair-share scheduler: runnable envs are kept in a binary min-heap ordered by virtual runtime,
+ * 'cfs_heap[1]' being the one which got the least CPU time for its weight so far.
+ *
+ * Invariant: 'env' is in the heap iff. 'env->env_status' is 'RUNNABLE', and then
+ * 'cfs_heap[env->env_heapx] == env'. The running env stays in the heap and is moved down as its
+ * virtual runtime grows.
+ */
+static struct Env *cfs_heap[NENV + 1];
+static u_int cfs_nr;		 // number of envs in the heap
+static u_int cfs_load;		 // sum of their weights
+static uint64_t cfs_min_vruntime; // never decreases
+static uint64_t cfs_exec_start;	 // when 'curenv' was last charged
+
+static u_int cfs_weight(struct Env *e) {
+	return 1 << (SCHED_WEIGHT_SHIFT + e->env_level);
+}
+
+static void cfs_set(u_int i, struct Env *e) {
+	cfs_heap[i] = e;
+	e->env_heapx = i;
+}
+
+static void cfs_up(u_int i) {
+	struct Env *e = cfs_heap[i];
+
+	for (; i > 1 && cfs_heap[i / 2]->env_vruntime > e->env_vruntime; i /= 2) {
+		cfs_set(i, cfs_heap[i / 2]);
+	}
+	cfs_set(i, e);
+}
+
+static void cfs_down(u_int i) {
+	struct Env *e = cfs_heap[i];
+	u_int c;
+
+	for (; (c = 2 * i) <= cfs_nr; i = c) {
+		if (c < cfs_nr && cfs_heap[c + 1]->env_vruntime < cfs_heap[c]->env_vruntime) {
+			c++;
+		}
+		if (cfs_heap[c]->env_vruntime >= e->env_vruntime) {
+			break;
+		}
+		cfs_set(i, cfs_heap[c]);
+	}
+	cfs_set(i, e);
+}
+
+// Return the runnable env with the least virtual runtime other than 'e', or NULL.
+static struct Env *cfs_first_other(struct Env *e) {
+	struct Env *a, *b;
+
+	if (cfs_nr == 0 || cfs_heap[1] != e) {
+		return cfs_nr == 0 ? NULL : cfs_heap[1];
+	}
+	a = cfs_nr >= 2 ? cfs_heap[2] : NULL;
+	b = cfs_nr >= 3 ? cfs_heap[3] : NULL;
+	return b != NULL && b->env_vruntime < a->env_vruntime ? b : a;
+}
+
+/* Overview:
+ *   Charge the CPU time of 'curenv' since 'cfs_exec_start' to its virtual runtime, scaled by
+ *   'SCHED_WEIGHT_DEFAULT / weight' (a shift, as weights are powers of 2), and advance
+ *   'cfs_min_vruntime'.
+ */
+static void cfs_update_curr(void) {
+	struct Env *e = curenv;
+	uint64_t now = kclock_now(), delta = now - cfs_exec_start;
+	int shift = SCHED_LEVEL_DEFAULT - (int)e->env_level;
+
+	cfs_exec_start = now;
+	e->env_vruntime += shift >= 0 ? delta << shift : delta >> -shift;
+	if (e->env_heapx != 0) {
+		cfs_down(e->env_heapx);
+	}
+	if (cfs_nr > 0 && cfs_heap[1]->env_vruntime > cfs_min_vruntime) {
+		cfs_min_vruntime = cfs_heap[1]->env_vruntime;
+	}
+}
+
+void sched_init(void) {
+	cfs_nr = cfs_load = 0;
+	cfs_min_vruntime = 0;
+}
+
+/* Overview:
+ *   Make 'e' runnable. A new env starts 'SCHED_FORK_DEBIT' after the least virtual runtime, a
+ *   waking one at most 'SCHED_WAKEUP_CREDIT' before it, so it runs soon, but can't use its
+ *   time asleep to starve the others afterwards. 'head' is not used.
+ */
+void sched_insert(struct Env *e, int head) {
+	if (e->env_vruntime == 0) {
+		e->env_vruntime = cfs_min_vruntime + SCHED_FORK_DEBIT;
+	} else if (e->env_vruntime + SCHED_WAKEUP_CREDIT < cfs_min_vruntime) {
+		e->env_vruntime = cfs_min_vruntime - SCHED_WAKEUP_CREDIT;
+	}
+	cfs_set(++cfs_nr, e);
+	cfs_up(cfs_nr);
+	cfs_load += cfs_weight(e);
+	ukdata->uk_runnable = cfs_nr;
+}
+
+/* Overview:
+ *   Remove 'e' from the heap. Does nothing if 'e' is not runnable.
+ */
+void sched_remove(struct Env *e) {
+	u_int i = e->env_heapx;
+	struct Env *last;
+
+	if (i == 0) {
+		return;
+	}
+	if (e == curenv) {
+		cfs_update_curr();
+		i = e->env_heapx;
+	}
+	e->env_heapx = 0;
+	cfs_load -= cfs_weight(e);
+	last = cfs_heap[cfs_nr--];
+	ukdata->uk_runnable = cfs_nr;
+	if (last != e) {
+		cfs_set(i, last);
+		cfs_up(i);
+		cfs_down(last->env_heapx);
+	}
+}
+
+void sched_set_level(struct Env *e, u_int level) {
+	int queued = e->env_heapx != 0;
+
+	sched_remove(e);
+	e->env_level = e->env_qlevel = level;
+	if (queued) {
+		sched_insert(e, 0);
+	}
+}
+
+// Fairness makes aging unnecessary.
+void sched_tick(void) {
+}
+
+/* Overview:
+ *   Return whether a runnable env is more than 'SCHED_WAKEUP_GRAN' behind 'curenv'.
+ */
+int sched_need_preempt(void) {
+	struct Env *first;
+
+	if (curenv == NULL || curenv->env_heapx == 0) {
+		return 0;
+	}
+	cfs_update_curr();
+	first = cfs_first_other(curenv);
+	return first != NULL && first->env_vruntime + SCHED_WAKEUP_GRAN < curenv->env_vruntime;
+}
+
+// Ticks of the slice of 'e': its share of 'SCHED_LATENCY_TICKS' by weight, at least one.
+static int cfs_slice(struct Env *e) {
+	return (SCHED_LATENCY_TICKS * cfs_weight(e) + cfs_load - 1) / cfs_load;
+}
+
+/* Overview:
+ *   Run the env with the least virtual runtime.
+ *
+ * Post-Condition:
+ *   If 'yield' is set (non-zero), 'curenv' is placed after the runnable env with the least
+ *   virtual runtime (other than itself), which runs next.
+ *   'curenv' keeps running until its slice ends, unless it blocks, yields, or another env is
+ *   more than 'SCHED_WAKEUP_GRAN' behind it. If no env is runnable, we wait in the idle loop.
+ */
+void schedule(int yield) {
+	static int count = 0; // remaining ticks of the slice of 'curenv'
+	struct Env *e = curenv, *first;
+
+	if (e != NULL) {
+		cfs_update_curr();
+	}
+	if (e != NULL && e->env_heapx != 0 && !yield && count > 0 &&
+	    !sched_need_preempt()) {
+		count--;
+		kclock_start_slice();
+		env_run(e);
+	}
+
+	if (e != NULL && e->env_heapx != 0 && yield && (first = cfs_first_other(e)) != NULL &&
+	    e->env_vruntime <= first->env_vruntime) {
+		e->env_vruntime = first->env_vruntime + 1;
+		cfs_down(e->env_heapx);
+	}
+	if (cfs_nr == 0) {
+		if (curenv != NULL) {
+			curenv->env_tf = *cur_tf;
+			curenv = NULL;
+		}
+		kclock_idle();
+	}
+	e = cfs_heap[1];
+	count = cfs_slice(e) - 1;
+	cfs_exec_start = kclock_now();
+	kclock_start_slice();
+	env_run(e);
+}
+
+/* Overview:
+ *   Switch to the runnable env 'e' for the rest of the slice of 'curenv'. Used to pass the CPU
+ *   along with an IPC message instead of waiting behind the other runnable envs; the time 'e'
+ *   runs is charged to its own virtual runtime as usual.
+ */
+void sched_handoff(struct Env *e) {
+	if (e->env_heapx == 0) {
+		schedule(1);
+	}
+	if (curenv != NULL) {
+		cfs_update_curr();
+	}
+	cfs_exec_start = kclock_now();
+	env_run(e);
+}
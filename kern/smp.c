@@ -0,0 +1,5 @@
+#include <smp.h>
+
+struct Cpu cpus[NCPU] = {
+    [0] = {.cpu_kstacktop = KSTACKTOP},
+};
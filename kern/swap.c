@@ -0,0 +1,276 @@
+#include <error.h>
+#include <io.h>
+#include <malta.h>
+#include <mmu.h>
+#include <pmap.h>
+#include <printk.h>
+#include <rmap.h>
+#include <swap.h>
+
+struct Swap_info swap_stat;
+
+static int swap_enabled;
+static uint32_t swap_bitmap[SWAP_NSLOTS / 32]; // bit set iff. the slot is in use
+static u_int swap_cursor;		       // next slot 'slot_alloc' looks at
+static u_long clock_hand;		       // next page the CLOCK scan looks at
+
+// A page chosen by the CLOCK scan, together with its only mapping.
+struct Swap_victim {
+	struct Page *pp;
+	struct Rmap *rm;
+	Pte *pte;
+	u_int slot;
+};
+
+/*
+ * Swap disk access. The secondary IDE channel is only used by the kernel, and the kernel is not
+ * preemptible, so every request is issued and completed here without interleaving.
+ */
+static uint8_t swapdev_wait(void) {
+	uint8_t status;
+
+	while ((status = ioread8(MALTA_IDE2_STATUS)) & MALTA_IDE_BUSY) {
+	}
+	if (status & MALTA_IDE_ERROR) {
+		panic("swap: disk error, status %x", status);
+	}
+	return status;
+}
+
+static void swapdev_start(u_int secno, u_int nsecs, uint8_t cmd) {
+	swapdev_wait();
+	iowrite8(nsecs & 0xff, MALTA_IDE2_NSECT); // 0 stands for 256 sectors
+	iowrite8(secno & 0xff, MALTA_IDE2_LBAL);
+	iowrite8((secno >> 8) & 0xff, MALTA_IDE2_LBAM);
+	iowrite8((secno >> 16) & 0xff, MALTA_IDE2_LBAH);
+	iowrite8(((secno >> 24) & 0x0f) | MALTA_IDE_LBA, MALTA_IDE2_DEVICE);
+	iowrite8(cmd, MALTA_IDE2_STATUS);
+}
+
+// Transfer one sector between 'buf' and the data port, once the device asks for it.
+static void swapdev_xfer(u_int *buf, int write) {
+	while ((swapdev_wait() & MALTA_IDE_DRQ) == 0) {
+	}
+	for (int i = 0; i < SWAP_SECT_SIZE / 4; i++) {
+		if (write) {
+			iowrite32(buf[i], MALTA_IDE2_DATA);
+		} else {
+			buf[i] = ioread32(MALTA_IDE2_DATA);
+		}
+	}
+}
+
+/* Overview:
+ *   Probe the swap disk, and enable swapping if it's present.
+ */
+void swap_init(void) {
+	iowrite8(MALTA_IDE_LBA, MALTA_IDE2_DEVICE);
+	iowrite8(0x55, MALTA_IDE2_NSECT);
+	iowrite8(0xaa, MALTA_IDE2_LBAL);
+	if (ioread8(MALTA_IDE2_NSECT) != 0x55 || ioread8(MALTA_IDE2_LBAL) != 0xaa) {
+		printk("swap: no swap disk\n");
+		return;
+	}
+	swap_enabled = 1;
+	swap_stat.si_slots = SWAP_NSLOTS;
+	printk("swap: %d KiB swap area\n", SWAP_NSLOTS * PAGE_SIZE / 1024);
+}
+
+static int slot_alloc(void) {
+	for (u_int n = 0; n < SWAP_NSLOTS; n++) {
+		u_int slot = swap_cursor;
+		swap_cursor = (swap_cursor + 1) % SWAP_NSLOTS;
+		if ((swap_bitmap[slot / 32] & (1 << (slot % 32))) == 0) {
+			swap_bitmap[slot / 32] |= 1 << (slot % 32);
+			swap_stat.si_used++;
+			return slot;
+		}
+	}
+	return -E_NO_MEM;
+}
+
+static void slot_free(u_int slot) {
+	assert(swap_bitmap[slot / 32] & (1 << (slot % 32)));
+	swap_bitmap[slot / 32] &= ~(1 << (slot % 32));
+	swap_stat.si_used--;
+}
+
+/* Overview:
+ *   Release the swap slot held by 'pte', a page table entry with 'PTE_SWAP' and without 'PTE_V'.
+ *   The caller clears the entry.
+ */
+void swap_free(Pte pte) {
+	slot_free(PPN(pte));
+}
+
+/* Overview:
+ *   Check whether 'pp' may be swapped out: it's mapped exactly once, below 'UTOP', and is not
+ *   shared memory ('PTE_LIBRARY'), whose reference count user space relies on, nor mapped by a
+ *   page table shared by 'fork', which is never given swapped out entries.
+ *
+ * Post-Condition:
+ *   Return 1 and set '*prm' and '*ppte' to the mapping if so, return 0 otherwise.
+ */
+static int swap_candidate(struct Page *pp, struct Rmap **prm, Pte **ppte) {
+	struct Rmap *rm = LIST_FIRST(&pp->pp_rmap);
+
+	if (pp->pp_ref != 1 || rm == NULL || LIST_NEXT(rm, rm_link) != NULL ||
+	    RMAP_VA(rm) >= UTOP) {
+		return 0;
+	}
+	if (page_lookup(rm->rm_pgdir, RMAP_VA(rm), ppte) != pp || (**ppte & PTE_LIBRARY) ||
+	    pgtable_shared(rm->rm_pgdir, RMAP_VA(rm))) {
+		return 0;
+	}
+	*prm = rm;
+	return 1;
+}
+
+/* Overview:
+ *   Swap out at most 'n' (and no more than 'SWAP_BATCH') cold pages.
+ *   The CLOCK hand sweeps once over 'pages': a candidate referenced since the last sweep gets
+ *   its 'PTE_REF' cleared (and its TLB entry dropped, so the next access sets it again),
+ *   otherwise it's chosen. Victims are written with as few IDE commands as their slots allow,
+ *   then their page table entries are turned into swap entries.
+ *
+ * Post-Condition:
+ *   Return the number of pages freed.
+ */
+int swap_out(u_int n) {
+	struct Swap_victim batch[SWAP_BATCH], *v;
+	struct Rmap *rm;
+	Pte *pte;
+	u_int nv = 0, i, j, k;
+	int slot;
+
+	if (!swap_enabled) {
+		return 0;
+	}
+	n = MIN(n, SWAP_BATCH);
+
+	for (u_long scanned = 0; scanned < npage && nv < n; scanned++) {
+		struct Page *pp = &pages[clock_hand];
+		clock_hand = (clock_hand + 1) % npage;
+		swap_stat.si_scanned++;
+
+		if (!swap_candidate(pp, &rm, &pte)) {
+			continue;
+		}
+		if (*pte & PTE_REF) {
+			*pte &= ~PTE_REF;
+			tlb_invalidate(RMAP_ASID(rm), RMAP_VA(rm));
+			continue;
+		}
+		if ((slot = slot_alloc()) < 0) {
+			break;
+		}
+		batch[nv++] = (struct Swap_victim){pp, rm, pte, slot};
+	}
+
+	// Write runs of consecutive slots with a single command each.
+	for (i = 0; i < nv; i = j) {
+		for (j = i + 1; j < nv && batch[j].slot == batch[j - 1].slot + 1; j++) {
+		}
+		swapdev_start(batch[i].slot * SWAP_SECT_PER_PAGE, (j - i) * SWAP_SECT_PER_PAGE,
+			      MALTA_IDE_CMD_PIO_WRITE);
+		for (k = i; k < j; k++) {
+			for (int s = 0; s < SWAP_SECT_PER_PAGE; s++) {
+				swapdev_xfer((u_int *)(page2kva(batch[k].pp) + s * SWAP_SECT_SIZE), 1);
+			}
+		}
+		swapdev_wait();
+		swap_stat.si_writes++;
+	}
+
+	for (i = 0; i < nv; i++) {
+		v = &batch[i];
+		Pde *pgdir = v->rm->rm_pgdir;
+		u_int asid = RMAP_ASID(v->rm);
+		u_long va = RMAP_VA(v->rm);
+
+		page_account(pgdir, asid, v->pp, va, *v->pte, -1);
+		*v->pte = (v->slot << PGSHIFT) | (PTE_FLAGS(*v->pte) & ~(PTE_V | PTE_REF)) | PTE_SWAP;
+		pa2page(pgdir[PDX(va)])->pp_noshare++;
+		rmap_remove(v->pp, pgdir, va);
+		tlb_invalidate(asid, va);
+		page_decref(v->pp);
+	}
+	swap_stat.si_pageouts += nv;
+	return nv;
+}
+
+// Return whether at least 'n' pages are on 'page_free_list'.
+static int free_pages_at_least(u_int n) {
+	struct Page *pp;
+
+	LIST_FOREACH (pp, &page_free_list, pp_link) {
+		if (--n == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Keep at least 'SWAP_LOW_WATER' pages free, so that the allocations of the caller (and the
+ *   page tables and reverse mappings they need) succeed.
+ *
+ * Pre-Condition:
+ *   Must only be called where no 'struct Page' or page table entry of a user page is held,
+ *   since any such page may be swapped out.
+ */
+void swap_balance(void) {
+	int idle = 0;
+
+	if (!swap_enabled) {
+		return;
+	}
+	// A sweep finding only referenced pages clears them, so the next one finds victims.
+	while (!free_pages_at_least(SWAP_LOW_WATER) && idle < 2) {
+		if (swap_out(SWAP_BATCH) == 0) {
+			idle++;
+		}
+	}
+}
+
+/* Overview:
+ *   If 'va' is swapped out in 'pgdir', read the page back and map it again.
+ *
+ * Post-Condition:
+ *   Return 1 if the page has been swapped in, 0 if 'va' is not swapped out.
+ *   Return -E_NO_MEM if we're out of memory.
+ */
+int swap_in(Pde *pgdir, u_int asid, u_long va) {
+	struct Page *pp;
+	Pde *pde = &pgdir[PDX(va)];
+	Pte *pte;
+	u_int slot;
+
+	if (!(*pde & PTE_V)) {
+		return 0;
+	}
+	pte = (Pte *)KADDR(PTE_ADDR(*pde)) + PTX(va);
+	if ((*pte & (PTE_SWAP | PTE_V)) != PTE_SWAP) {
+		return 0;
+	}
+
+	swap_balance();
+	try(page_alloc(&pp));
+	slot = PPN(*pte);
+	swapdev_start(slot * SWAP_SECT_PER_PAGE, SWAP_SECT_PER_PAGE, MALTA_IDE_CMD_PIO_READ);
+	for (int s = 0; s < SWAP_SECT_PER_PAGE; s++) {
+		swapdev_xfer((u_int *)(page2kva(pp) + s * SWAP_SECT_SIZE), 0);
+	}
+	if (rmap_add(pp, pgdir, asid, va) != 0) {
+		page_free(pp);
+		return -E_NO_MEM;
+	}
+
+	slot_free(slot);
+	pa2page(*pde)->pp_noshare--;
+	*pte = page2pa(pp) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_V | PTE_REF;
+	pp->pp_ref++;
+	page_account(pgdir, asid, pp, va, *pte, 1);
+	swap_stat.si_pageins++;
+	return 1;
+}
@@ -1,12 +1,22 @@
+#include <elf.h>
 #include <env.h>
+#include <futex.h>
 #include <io.h>
+#include <kclock.h>
+#include <kmem.h>
+#include <ksm.h>
+#include <swap.h>
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
 #include <sched.h>
 #include <syscall.h>
+#include <sysstat.h>
+#include <timer.h>
 
-extern struct Env *curenv;
+// Whether 'sys_multicall' is running a batch. 'sys_env_destroy' and 'sys_set_env_status' switch
+// envs when applied to 'curenv', which a batched syscall must not do, so they refuse to then.
+static int in_multicall;
 
 /* Overview:
  * 	This function is used to print a character on screen.
@@ -78,12 +88,17 @@ void __attribute__((noreturn)) sys_yield(void)
  *
  * Post-Condition:
  *  Returns 0 on success.
+ *  Returns -E_INVAL if `envid` is the caller and the call is batched by `sys_multicall`.
  *  Returns the original error if underlying calls fail.
  */
 int sys_env_destroy(u_int envid)
 {
 	struct Env *e;
 	try(envid2env(envid, &e, 1));
+	if (in_multicall && e == curenv)
+	{
+		return -E_INVAL;
+	}
 
 	printk("[%08x] destroying %08x\n", curenv->env_id, e->env_id);
 	env_destroy(e);
@@ -130,6 +145,42 @@ static inline int is_illegal_va_range(u_long va, u_int len)
 	return va + len < va || va < UTEMP || va + len > UTOP;
 }
 
+/* Overview:
+ *   Find the page mapped at 'va' in 'e', to be mapped elsewhere with 'perm'. A swapped out page
+ *   is read back first.
+ *   Write access to a copy-on-write page (shared after 'fork', merged by the KSM scanner, or the
+ *   zero page) is granted to a private copy, so that the other users of the page never see the
+ *   writes.
+ *
+ * Post-Condition:
+ *   Return 0 and set '*ppp' on success, -E_INVAL if 'va' is unmapped, or -E_NO_MEM if we're out
+ *   of memory.
+ */
+static int lookup_for_map(struct Env *e, u_int va, u_int perm, struct Page **ppp)
+{
+	Pte *pte;
+
+	if (swap_in(e->env_pgdir, e->env_asid, va) < 0)
+	{
+		return -E_NO_MEM;
+	}
+	/* A writable page in a page table shared by 'fork' is copy-on-write for its users. */
+	if (perm & PTE_D)
+	{
+		try(pgtable_unshare(e->env_pgdir, e->env_asid, va));
+	}
+	if ((*ppp = page_lookup(e->env_pgdir, va, &pte)) == NULL)
+	{
+		return -E_INVAL;
+	}
+	if ((*pte & PTE_COW) && (perm & PTE_D) && !(perm & PTE_COW))
+	{
+		try(cow_break(e->env_pgdir, e->env_asid, va));
+		*ppp = page_lookup(e->env_pgdir, va, NULL);
+	}
+	return 0;
+}
+
 /* Overview:
  *   Allocate a physical page and map 'va' to it with 'perm' in the address space of 'envid'.
  *   If 'va' is already mapped, that original page is sliently unmapped.
@@ -165,6 +216,7 @@ int sys_mem_alloc(u_int envid, u_int va, u_int perm)
 
 	/* Step 3: Allocate a physical page using 'page_alloc'. */
 	/* Exercise 4.4: Your code here. (3/3) */
+	swap_balance();
 	try(page_alloc(&pp));
 
 	/* Step 4: Map the allocated page at 'va' with permission 'perm' using 'page_insert'. */
@@ -210,11 +262,7 @@ int sys_mem_map(u_int srcid, u_int srcva, u_int dstid, u_int dstva, u_int perm)
 	/* Step 4: Find the physical page mapped at 'srcva' in the address space of 'srcid'. */
 	/* Return -E_INVAL if 'srcva' is not mapped. */
 	/* Exercise 4.5: Your code here. (4/4) */
-	pp = page_lookup(srcenv->env_pgdir, srcva, NULL);
-	if (pp == NULL)
-	{
-		return -E_INVAL;
-	}
+	try(lookup_for_map(srcenv, srcva, perm, &pp));
 
 	/* Step 5: Map the physical page at 'dstva' in the address space of 'dstid'. */
 	return page_insert(dstenv->env_pgdir, dstenv->env_asid, pp, dstva, perm);
@@ -246,25 +294,133 @@ int sys_mem_unmap(u_int envid, u_int va)
 	try(envid2env(envid, &e, 1));
 
 	/* Step 3: Unmap the physical page at 'va' in the address space of 'envid'. */
+	try(pgtable_unshare(e->env_pgdir, e->env_asid, va));
 	page_remove(e->env_pgdir, e->env_asid, va);
 	return 0;
 }
 
 /* Overview:
- *   Allocate a new env as a child of 'curenv'.
+ *   Range variant of 'sys_mem_alloc': map 'npages' newly allocated pages from 'va' on with 'perm'
+ *   in the address space of 'envid', with one permission check and the TLB invalidated once.
  *
  * Post-Condition:
- *   Returns the child's envid on success, and
+ *   Return 0 on success.
+ *   Return -E_INVAL if the range is not legal, or an error of 'envid2env', 'page_alloc' or
+ *   'page_insert'; the pages before the one which failed stay mapped.
+ */
+int sys_mem_alloc_range(u_int envid, u_int va, u_int npages, u_int perm)
+{
+	struct Env *env;
+	struct Page *pp;
+	u_int i;
+	int r = 0;
+
+	if (npages > (UTOP >> PGSHIFT) || is_illegal_va_range(va, npages << PGSHIFT))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &env, 1));
+
+	tlb_batch_begin(env->env_asid);
+	for (i = 0; i < npages && r == 0; i++)
+	{
+		swap_balance();
+		if ((r = page_alloc(&pp)) == 0)
+		{
+			r = page_insert(env->env_pgdir, env->env_asid, pp, va + (i << PGSHIFT), perm);
+		}
+	}
+	tlb_batch_end();
+	return r;
+}
+
+/* Overview:
+ *   Range variant of 'sys_mem_map': map the 'npages' pages from 'srcva' on in 'srcid' at 'dstva'
+ *   on in 'dstid', where 'perm_npages' is 'perm | npages << PGSHIFT'.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL if a range is not legal or a source page is not mapped, or an error of
+ *   'envid2env' or 'page_insert'; the pages before the one which failed stay mapped.
+ */
+int sys_mem_map_range(u_int srcid, u_int srcva, u_int dstid, u_int dstva, u_int perm_npages)
+{
+	struct Env *srcenv;
+	struct Env *dstenv;
+	struct Page *pp;
+	u_int npages = perm_npages >> PGSHIFT, perm = perm_npages & (PAGE_SIZE - 1);
+	u_int i;
+	int r = 0;
+
+	if (npages > (UTOP >> PGSHIFT) || is_illegal_va_range(srcva, npages << PGSHIFT) ||
+	    is_illegal_va_range(dstva, npages << PGSHIFT))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(srcid, &srcenv, 1));
+	try(envid2env(dstid, &dstenv, 1));
+
+	tlb_batch_begin(dstenv->env_asid);
+	for (i = 0; i < npages && r == 0; i++)
+	{
+		if ((r = lookup_for_map(srcenv, srcva + (i << PGSHIFT), perm, &pp)) == 0)
+		{
+			r = page_insert(dstenv->env_pgdir, dstenv->env_asid, pp,
+					dstva + (i << PGSHIFT), perm);
+		}
+	}
+	tlb_batch_end();
+	return r;
+}
+
+/* Overview:
+ *   Range variant of 'sys_mem_unmap': unmap the 'npages' pages from 'va' on in the address
+ *   space of 'envid'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_INVAL if the range is not legal, or an error of 'envid2env'.
+ *   Return -E_NO_MEM if a page table shared by 'fork' cannot be copied (then only part of the
+ *   pages are unmapped).
+ */
+int sys_mem_unmap_range(u_int envid, u_int va, u_int npages)
+{
+	struct Env *e;
+	u_int i;
+	int r = 0;
+
+	if (npages > (UTOP >> PGSHIFT) || is_illegal_va_range(va, npages << PGSHIFT))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 1));
+
+	tlb_batch_begin(e->env_asid);
+	for (i = 0; i < npages && r == 0; i++)
+	{
+		if ((r = pgtable_unshare(e->env_pgdir, e->env_asid, va + (i << PGSHIFT))) == 0)
+		{
+			page_remove(e->env_pgdir, e->env_asid, va + (i << PGSHIFT));
+		}
+	}
+	tlb_batch_end();
+	return r;
+}
+
+/* Overview:
+ *   Allocate a new env as a child of 'curenv', and store it in '*pe'.
+ *
+ * Post-Condition:
+ *   Returns 0 on success, and
  *   - The new env's 'env_tf' is copied from the kernel stack, except for $v0 set to 0 to indicate
  *     the return value in child.
  *   - The new env's 'env_status' is set to 'ENV_NOT_RUNNABLE'.
- *   - The new env's 'env_pri' is copied from 'curenv'.
+ *   - The new env's 'env_pri' and 'env_level' are copied from 'curenv'.
  *   Returns the original error if underlying calls fail.
  *
  * Hint:
  *   This syscall works as an essential step in user-space 'fork' and 'spawn'.
  */
-int sys_exofork(void)
+static int exofork(struct Env **pe)
 {
 	struct Env *e;
 
@@ -272,9 +428,9 @@ int sys_exofork(void)
 	/* Exercise 4.9: Your code here. (1/4) */
 	try(env_alloc(&e, curenv->env_id));
 
-	/* Step 2: Copy the current Trapframe below 'KSTACKTOP' to the new env's 'env_tf'. */
+	/* Step 2: Copy the current Trapframe 'cur_tf' to the new env's 'env_tf'. */
 	/* Exercise 4.9: Your code here. (2/4) */
-	e->env_tf = *((struct Trapframe *)KSTACKTOP - 1);
+	e->env_tf = *cur_tf;
 
 	/* Step 3: Set the new env's 'env_tf.regs[2]' to 0 to indicate the return value in child. */
 	/* Exercise 4.9: Your code here. (3/4) */
@@ -284,22 +440,284 @@ int sys_exofork(void)
 	/* Exercise 4.9: Your code here. (4/4) */
 	e->env_status = ENV_NOT_RUNNABLE;
 	e->env_pri = curenv->env_pri;
+	e->env_level = e->env_qlevel = curenv->env_level;
 	e->env_shell_id = curenv->env_shell_id;
 	env_copy_vars(e, curenv);
 
+	*pe = e;
+	return 0;
+}
+
+/* Overview:
+ *   Allocate a new env as a child of 'curenv' (see 'exofork') and return its envid.
+ */
+int sys_exofork(void)
+{
+	struct Env *e;
+
+	try(exofork(&e));
+	return e->env_id;
+}
+
+/* Overview:
+ *   Fork 'curenv' in one syscall: create a child as 'sys_exofork' does, share the address space
+ *   below 'USTACKTOP' with it copy-on-write in one pass over the page tables (see 'pgdir_fork'),
+ *   give it our TLB Mod user exception entry, and make it runnable.
+ *   Copy-on-write faults are then handled as after the user-level 'fork'.
+ *
+ * Post-Condition:
+ *   Return the envid of the child to the parent, and 0 to the child.
+ *   Return -E_NO_MEM if we're out of memory, or the original error of 'env_alloc'.
+ */
+int sys_fork(void)
+{
+	struct Env *e;
+	int r;
+
+	swap_balance();
+	try(exofork(&e));
+	e->env_user_tlb_mod_entry = curenv->env_user_tlb_mod_entry;
+	if ((r = pgdir_fork(curenv->env_pgdir, curenv->env_asid, e->env_pgdir, e->env_asid,
+			    USTACKTOP)) < 0)
+	{
+		env_free(e);
+		return r;
+	}
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
+	return e->env_id;
+}
+
+/* Overview:
+ *   The 'elf_mapper_t' of 'sys_spawn': map a page of a segment in the env 'data', with 'len'
+ *   bytes of the image (in the memory of 'curenv') copied from 'src' at 'offset'.
+ *   Writable pages without any content from the image are not mapped at all: the page faults of
+ *   the env map them on demand (see 'passive_alloc'), so a large bss costs nothing up front.
+ *   Whole read-only pages of the image are not copied either if they are shared memory, i.e. the
+ *   blocks of the file cached by the file server that 'open' maps: the env maps them read-only,
+ *   so all the envs running a program share one copy of its text.
+ */
+static int spawn_mapper(void *data, u_long va, size_t offset, u_int perm, const void *src,
+						size_t len)
+{
+	struct Env *e = (struct Env *)data;
+	struct Page *p;
+	Pte *pte;
+
+	if (src == NULL && (perm & PTE_D))
+	{
+		return 0;
+	}
+	if (!(perm & PTE_D) && offset == 0 && len == PAGE_SIZE &&
+		((u_long)src & (PAGE_SIZE - 1)) == 0 &&
+		(p = page_lookup(cur_pgdir, (u_long)src, &pte)) != NULL && (*pte & PTE_LIBRARY))
+	{
+		return page_insert(e->env_pgdir, e->env_asid, p, va, perm);
+	}
+	try(page_alloc(&p));
+	if (src != NULL)
+	{
+		memcpy((void *)page2kva(p) + offset, src, len);
+	}
+	if (page_insert(e->env_pgdir, e->env_asid, p, va, perm) != 0)
+	{
+		page_free(p);
+		return -E_NO_MEM;
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Set up the stack page of 'e' below 'USTACKTOP' like 'init_stack' in user/lib/spawn.c does:
+ *   the strings of 'argv' (a NULL-terminated array in the memory of 'curenv') at the top, the
+ *   array of their addresses in 'e' below them, then 'argv' and 'argc' for 'main'.
+ *
+ * Post-Condition:
+ *   Return 0 and set '*sp' to the initial stack pointer of 'e' on success.
+ *   Return -E_INVAL if 'argv' or one of its strings is not in user memory, or -E_NO_MEM if they
+ *   don't fit in the page or we're out of memory.
+ */
+static int spawn_stack(struct Env *e, char **argv, u_int *sp)
+{
+	u_int argc, tot = 0, n, *args;
+	struct Page *p;
+	char *s, *strings;
+	u_long kva;
+
+	for (argc = 0;; argc++)
+	{
+		if (is_illegal_va_range((u_long)&argv[argc], sizeof(char *)))
+		{
+			return -E_INVAL;
+		}
+		if ((s = argv[argc]) == NULL)
+		{
+			break;
+		}
+		for (n = 0;; n++)
+		{
+			if (is_illegal_va((u_long)s + n))
+			{
+				return -E_INVAL;
+			}
+			if (ROUND(tot + n + 1, 4) + 4 * (argc + 4) > PAGE_SIZE)
+			{
+				return -E_NO_MEM;
+			}
+			if (s[n] == '\0')
+			{
+				break;
+			}
+		}
+		tot += n + 1;
+	}
+
+	try(page_alloc(&p));
+	kva = page2kva(p);
+	strings = (char *)(kva + PAGE_SIZE - tot);
+	args = (u_int *)(kva + PAGE_SIZE - ROUND(tot, 4) - 4 * (argc + 1));
+#define CHILD_VA(x) (USTACKTOP - PAGE_SIZE + ((u_long)(x) - kva))
+	for (n = 0; n < argc; n++)
+	{
+		args[n] = CHILD_VA(strings);
+		strcpy(strings, argv[n]);
+		strings += strlen(strings) + 1;
+	}
+	args[argc] = 0;
+	args[-1] = CHILD_VA(args);
+	args[-2] = argc;
+	*sp = CHILD_VA(&args[-2]);
+#undef CHILD_VA
+
+	if (page_insert(e->env_pgdir, e->env_asid, p, USTACKTOP - PAGE_SIZE, PTE_D) != 0)
+	{
+		page_free(p);
+		return -E_NO_MEM;
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Map the shared memory ('PTE_LIBRARY') of 'curenv' below 'USTACKTOP' at the same addresses in
+ *   'e', with the same permissions, except for the image being spawned ('size' bytes at 'image')
+ *   and its file descriptor page at 'fdva': the child would get the file open, and the block
+ *   cache pages of its own text mapped writable. Only page tables holding such mappings are
+ *   looked at.
+ */
+static int spawn_share(struct Env *e, u_int image, u_int size, u_int fdva)
+{
+	Pde *pgdir = curenv->env_pgdir;
+	struct Page *pp;
+	u_long va;
+	Pte *pte;
+
+	for (va = 0; va < USTACKTOP; va += PAGE_SIZE)
+	{
+		if (!(pgdir[PDX(va)] & PTE_V) || pa2page(pgdir[PDX(va)])->pp_noshare == 0)
+		{
+			va = ROUNDDOWN(va, PDMAP) + PDMAP - PAGE_SIZE;
+			continue;
+		}
+		if (va == fdva || (va >= ROUNDDOWN(image, PAGE_SIZE) && va < image + size))
+		{
+			continue;
+		}
+		if ((pp = page_lookup(pgdir, va, &pte)) != NULL && (*pte & PTE_LIBRARY))
+		{
+			try(page_insert(e->env_pgdir, e->env_asid, pp, va, PTE_FLAGS(*pte)));
+		}
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Spawn a program from its ELF image, mapped at 'image' ('size' bytes) in the memory of
+ *   'curenv' (as 'open' maps files), with the arguments 'argv': create a child as
+ *   'sys_exofork' does, load the segments of the image and the arguments into its memory, share
+ *   our shared memory ('PTE_LIBRARY') with it, except for the image and the page at 'fdva' (the
+ *   file descriptor it was opened with, 0 if none), and make it runnable at the entry point.
+ *   This is what 'spawn' in user/lib/spawn.c used to do with several syscalls per page.
+ *
+ * Post-Condition:
+ *   Return the envid of the child on success.
+ *   Return -E_INVAL if the image or 'argv' is not in user memory, -E_NOT_EXEC if the image is
+ *   not a valid executable, -E_NO_MEM if we're out of memory, or the original error of
+ *   'env_alloc'.
+ */
+int sys_spawn(u_int image, u_int size, char **argv, u_int fdva)
+{
+	const Elf32_Ehdr *ehdr;
+	Elf32_Phdr *ph;
+	struct Env *e;
+	size_t ph_off;
+	u_int sp;
+	int r;
+
+	if (is_illegal_va_range(image, size))
+	{
+		return -E_INVAL;
+	}
+	if ((ehdr = elf_from((void *)image, size)) == NULL)
+	{
+		return -E_NOT_EXEC;
+	}
+	ELF_FOREACH_PHDR_OFF (ph_off, ehdr)
+	{
+		ph = (Elf32_Phdr *)(image + ph_off);
+		if (ph_off > size || size - ph_off < sizeof(Elf32_Phdr))
+		{
+			return -E_NOT_EXEC;
+		}
+		if (ph->p_type == PT_LOAD &&
+			(ph->p_offset > size || size - ph->p_offset < ph->p_filesz ||
+			 ph->p_filesz > ph->p_memsz || is_illegal_va_range(ph->p_vaddr, ph->p_memsz)))
+		{
+			return -E_NOT_EXEC;
+		}
+	}
+
+	swap_balance();
+	try(exofork(&e));
+	if ((r = spawn_stack(e, argv, &sp)) != 0)
+	{
+		goto err;
+	}
+	ELF_FOREACH_PHDR_OFF (ph_off, ehdr)
+	{
+		ph = (Elf32_Phdr *)(image + ph_off);
+		if (ph->p_type == PT_LOAD &&
+			(r = elf_load_seg(ph, (void *)image + ph->p_offset, spawn_mapper, e)) != 0)
+		{
+			goto err;
+		}
+	}
+	if ((r = spawn_share(e, image, size, fdva)) != 0)
+	{
+		goto err;
+	}
+
+	e->env_tf.cp0_epc = ehdr->e_entry;
+	e->env_tf.regs[29] = sp;
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
 	return e->env_id;
+
+err:
+	env_free(e);
+	return r;
 }
 
 /* Overview:
- *   Set 'envid''s 'env_status' to 'status' and update 'env_sched_list'.
+ *   Set 'envid''s 'env_status' to 'status' and update the run queues.
  *
  * Post-Condition:
  *   Returns 0 on success.
- *   Returns -E_INVAL if 'status' is neither 'ENV_RUNNABLE' nor 'ENV_NOT_RUNNABLE'.
+ *   Returns -E_INVAL if 'status' is neither 'ENV_RUNNABLE' nor 'ENV_NOT_RUNNABLE', or if 'envid'
+ *   is 'curenv' and the call is batched by 'sys_multicall'.
  *   Returns the original error if underlying calls fail.
  *
  * Hint:
- *   The invariant that 'env_sched_list' contains and only contains all runnable envs should be
+ *   The invariant that the run queues contain and only contain all runnable envs should be
  *   maintained.
  */
 int sys_set_env_status(u_int envid, u_int status)
@@ -316,16 +734,23 @@ int sys_set_env_status(u_int envid, u_int status)
 	/* Step 2: Convert the envid to its corresponding 'struct Env *' using 'envid2env'. */
 	/* Exercise 4.14: Your code here. (2/3) */
 	try(envid2env(envid, &env, 1));
+	if (in_multicall && env == curenv)
+	{
+		return -E_INVAL;
+	}
 
-	/* Step 3: Update 'env_sched_list' if the 'env_status' of 'env' is being changed. */
+	/* Step 3: Update the run queues if the 'env_status' of 'env' is being changed. */
 	/* Exercise 4.14: Your code here. (3/3) */
 	if (status == ENV_RUNNABLE && env->env_status != ENV_RUNNABLE)
 	{
-		TAILQ_INSERT_TAIL(&env_sched_list, env, env_sched_link);
+		timer_cancel(env);
+		futex_cancel(env);
+		ipc_interrupt(env);
+		sched_insert(env, 0);
 	}
 	else if (status == ENV_NOT_RUNNABLE && env->env_status != ENV_NOT_RUNNABLE)
 	{
-		TAILQ_REMOVE(&env_sched_list, env, env_sched_link);
+		sched_remove(env);
 	}
 
 	/* Step 4: Set the 'env_status' of 'env'. */
@@ -359,7 +784,7 @@ int sys_set_trapframe(u_int envid, struct Trapframe *tf)
 	try(envid2env(envid, &env, 1));
 	if (env == curenv)
 	{
-		*((struct Trapframe *)KSTACKTOP - 1) = *tf;
+		*cur_tf = *tf;
 		// return `tf->regs[2]` instead of 0, because return value overrides regs[2] on
 		// current trapframe.
 		return tf->regs[2];
@@ -382,9 +807,254 @@ void sys_panic(char *msg)
 	panic("%s", TRUP(msg));
 }
 
+/* Overview:
+ *   Find the page at 'srcva' (if not 0) in 'from' to be sent with 'perm', before the receiver
+ *   of the message is changed in any way.
+ *
+ * Post-Condition:
+ *   Return 0 and set '*pp' (to NULL if 'srcva' is 0) on success, -E_INVAL if 'srcva' is not
+ *   mapped in 'from', or the original error when underlying calls fail.
+ */
+static int ipc_lookup(struct Env *from, u_int srcva, u_int perm, struct Page **pp)
+{
+	*pp = NULL;
+	/* Return -E_INVAL if 'srcva' is not zero and not mapped in 'from'. */
+	if (srcva != 0)
+	{
+		return lookup_for_map(from, srcva, perm, pp);
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Pass a message ('value', together with the page 'p' found by 'ipc_lookup' if not NULL)
+ *   from 'from' to 'to', which is waiting for it (see 'ipc_can_send'), and stop 'to' receiving.
+ *   'to' is not woken up.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or the original error when underlying calls fail. The value is passed
+ *   even then.
+ */
+static int ipc_transfer(struct Env *from, struct Env *to, u_int value, struct Page *p,
+			u_int perm)
+{
+	/* Step 4: Set the target's ipc fields. */
+	to->env_ipc_value = value;
+	to->env_ipc_from = from->env_id;
+	to->env_ipc_perm = PTE_V | perm;
+	to->env_ipc_recving = 0;
+	to->env_ipc_callee = 0;
+
+	/* Step 6: If a page is sent, map it to 'to->env_ipc_dstva' in 'to'. */
+	if (p != NULL)
+	{
+		/* Exercise 4.8: Your code here. (8/8) */
+		try(page_insert(to->env_pgdir, to->env_asid, p, to->env_ipc_dstva, perm));
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Return whether 'to' is waiting for a message 'from' may send: any message if it's in
+ *   'sys_ipc_recv', only the reply of the callee if it's in 'sys_ipc_call'.
+ */
+static int ipc_can_send(struct Env *from, struct Env *to)
+{
+	return to->env_ipc_recving && (to->env_ipc_callee == 0 || to->env_ipc_callee == from->env_id);
+}
+
+/* Overview:
+ *   Wake up 'e', blocked sending in 'ipc_block_send', its syscall returning 'r'.
+ */
+static void ipc_wake_sender(struct Env *e, int r)
+{
+	e->env_tf.regs[2] = r;
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
+}
+
+/* Overview:
+ *   Remove 'e' from the senders of the env it's blocked sending to, if any, dropping its
+ *   message.
+ */
+void ipc_cancel(struct Env *e)
+{
+	if (e->env_ipc_send_to == NULL)
+	{
+		return;
+	}
+	TAILQ_REMOVE(&e->env_ipc_send_to->env_ipc_senders, e, env_ipc_send_link);
+	e->env_ipc_send_to = NULL;
+	e->env_ipc_callee = 0;
+}
+
+/* Overview:
+ *   Stop 'e', which 'sys_set_env_status' makes runnable, waiting in 'sys_ipc_send' or
+ *   'sys_ipc_call': its message is dropped, or it no longer waits for the reply to the request
+ *   already taken, and the syscall fails with -E_IPC_NOT_RECV.
+ */
+void ipc_interrupt(struct Env *e)
+{
+	if (e->env_ipc_send_to == NULL && e->env_ipc_callee == 0)
+	{
+		return;
+	}
+	ipc_cancel(e);
+	e->env_ipc_recving = 0;
+	e->env_ipc_callee = 0;
+	e->env_tf.regs[2] = -E_IPC_NOT_RECV;
+}
+
+/* Overview:
+ *   Wake up all the envs blocked sending to 'e', which is being freed, and those in
+ *   'sys_ipc_call' whose request 'e' has taken and which wait for its reply, their syscalls
+ *   failing with -E_BAD_ENV.
+ */
+void ipc_drop_senders(struct Env *e)
+{
+	extern struct Env envs[];
+	struct Env *s;
+
+	while ((s = TAILQ_FIRST(&e->env_ipc_senders)) != NULL)
+	{
+		ipc_cancel(s);
+		ipc_wake_sender(s, -E_BAD_ENV);
+	}
+	for (s = envs; s < envs + NENV; s++)
+	{
+		if (s->env_status == ENV_NOT_RUNNABLE && s->env_ipc_recving &&
+		    s->env_ipc_callee == e->env_id)
+		{
+			s->env_ipc_recving = 0;
+			s->env_ipc_callee = 0;
+			ipc_wake_sender(s, -E_BAD_ENV);
+		}
+	}
+}
+
+/* Overview:
+ *   Block 'curenv' sending a message to 'e', which can't receive it yet, until 'e' takes it in
+ *   'ipc_wait'. The senders to an env are queued on it, and it takes their messages in the
+ *   order they started waiting.
+ *
+ * Post-Condition:
+ *   The syscall returns 0 to 'curenv' once its message is received (or, in 'sys_ipc_call',
+ *   once the reply is), as 'ipc_take_sender' does.
+ */
+static void ipc_block_send(struct Env *e, u_int value, u_int srcva, u_int perm)
+	__attribute__((noreturn));
+static void ipc_block_send(struct Env *e, u_int value, u_int srcva, u_int perm)
+{
+	curenv->env_ipc_send_value = value;
+	curenv->env_ipc_send_srcva = srcva;
+	curenv->env_ipc_send_perm = perm;
+	curenv->env_ipc_send_to = e;
+	TAILQ_INSERT_TAIL(&e->env_ipc_senders, curenv, env_ipc_send_link);
+
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	sched_remove(curenv);
+	cur_tf->regs[2] = 0;
+	schedule(1);
+}
+
+/* Overview:
+ *   Take the message of the env which has been blocked sending to 'curenv' the longest, among
+ *   those 'curenv' accepts a message from (see 'ipc_can_send'). The sender is woken up, or, if
+ *   it's in 'sys_ipc_call', left waiting for the reply.
+ *
+ * Post-Condition:
+ *   Return whether a message was taken. A sender whose page has been unmapped since it blocked
+ *   is woken up with the error of 'ipc_lookup' instead, and the next one is tried.
+ */
+static int ipc_take_sender(void)
+{
+	struct Env *s;
+	struct Page *p;
+	u_int callee;
+	int r;
+
+	do
+	{
+		TAILQ_FOREACH (s, &curenv->env_ipc_senders, env_ipc_send_link)
+		{
+			if (ipc_can_send(s, curenv))
+			{
+				break;
+			}
+		}
+		if (s == NULL)
+		{
+			return 0;
+		}
+
+		callee = s->env_ipc_callee;
+		ipc_cancel(s);
+		if ((r = ipc_lookup(s, s->env_ipc_send_srcva, s->env_ipc_send_perm, &p)) != 0)
+		{
+			ipc_wake_sender(s, r);
+		}
+	} while (r != 0);
+
+	r = ipc_transfer(s, curenv, s->env_ipc_send_value, p, s->env_ipc_send_perm);
+	if (callee != 0 && r == 0)
+	{
+		// 'env_ipc_dstva' was set by 'sys_ipc_call'.
+		s->env_ipc_callee = callee;
+		s->env_ipc_recving = 1;
+	}
+	else
+	{
+		ipc_wake_sender(s, r);
+	}
+	return 1;
+}
+
+/* Overview:
+ *   Wait for a message to 'curenv', received at 'dstva' (if not 0). If an env is blocked sending
+ *   one we accept, take it without blocking. Otherwise block, and if we have just woken a
+ *   receiver, most likely with a request we now wait for the reply to (or with a reply before
+ *   waiting for the next request), run it for the rest of our slice.
+ *
+ * Post-Condition:
+ *   The syscall returns 0 to 'curenv' once it has received a message.
+ */
+static int ipc_wait(u_int dstva)
+{
+	struct Env *e;
+
+	/* Step 2: Set 'curenv->env_ipc_recving' to 1. */
+	/* Exercise 4.8: Your code here. (1/8) */
+	curenv->env_ipc_recving = 1;
+
+	/* Step 3: Set the value of 'curenv->env_ipc_dstva'. */
+	/* Exercise 4.8: Your code here. (2/8) */
+	curenv->env_ipc_dstva = dstva;
+
+	if (ipc_take_sender())
+	{
+		return 0;
+	}
+
+	/* Step 4: Set the status of 'curenv' to 'ENV_NOT_RUNNABLE' and remove it from its run
+	 * queue. */
+	/* Exercise 4.8: Your code here. (3/8) */
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	sched_remove(curenv);
+
+	/* Step 5: Give up the CPU and block until a message is received. */
+	cur_tf->regs[2] = 0;
+	if (curenv->env_ipc_wakee != 0 && envid2env(curenv->env_ipc_wakee, &e, 0) == 0 &&
+	    e->env_status == ENV_RUNNABLE)
+	{
+		curenv->env_ipc_wakee = 0;
+		sched_handoff(e);
+	}
+	schedule(1);
+}
+
 /* Overview:
  *   Wait for a message (a value, together with a page if 'dstva' is not 0) from other envs.
- *   'curenv' is blocked until a message is sent.
+ *   'curenv' is blocked until a message is sent, unless an env is blocked sending one already.
  *
  * Post-Condition:
  *   Return 0 on success.
@@ -397,24 +1067,31 @@ int sys_ipc_recv(u_int dstva)
 	{
 		return -E_INVAL;
 	}
+	return ipc_wait(dstva);
+}
 
-	/* Step 2: Set 'curenv->env_ipc_recving' to 1. */
-	/* Exercise 4.8: Your code here. (1/8) */
-	curenv->env_ipc_recving = 1;
+/* Overview:
+ *   Deliver a message to 'e', which 'curenv' may send to (see 'ipc_can_send'): wake it up, and
+ *   if 'srcva' is not 0, map the page at 'srcva' in 'curenv' at its 'env_ipc_dstva' with 'perm'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_INVAL if 'srcva' is not mapped in 'curenv', or the original error
+ *   when underlying calls fail. 'e' is left as it was if 'ipc_lookup' fails.
+ */
+static int ipc_deliver(struct Env *e, u_int value, u_int srcva, u_int perm)
+{
+	struct Page *p;
 
-	/* Step 3: Set the value of 'curenv->env_ipc_dstva'. */
-	/* Exercise 4.8: Your code here. (2/8) */
-	curenv->env_ipc_dstva = dstva;
+	try(ipc_lookup(curenv, srcva, perm, &p));
 
-	/* Step 4: Set the status of 'curenv' to 'ENV_NOT_RUNNABLE' and remove it from
-	 * 'env_sched_list'. */
-	/* Exercise 4.8: Your code here. (3/8) */
-	curenv->env_status = ENV_NOT_RUNNABLE;
-	TAILQ_REMOVE(&env_sched_list, curenv, env_sched_link);
+	/* Step 5: Set the target's status to 'ENV_RUNNABLE' again and insert it to the tail of
+	 * its run queue. It runs next once we block receiving. */
+	/* Exercise 4.8: Your code here. (7/8) */
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
+	curenv->env_ipc_wakee = e->env_id;
 
-	/* Step 5: Give up the CPU and block until a message is received. */
-	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
-	schedule(1);
+	return ipc_transfer(curenv, e, value, p, perm);
 }
 
 /* Overview:
@@ -430,13 +1107,12 @@ int sys_ipc_recv(u_int dstva)
  *     with 'perm'.
  *
  *   Return -E_IPC_NOT_RECV if the target has not been waiting for an IPC message with
- *   'sys_ipc_recv'.
+ *   'sys_ipc_recv', or is waiting for the reply of another env in 'sys_ipc_call'.
  *   Return the original error when underlying calls fail.
  */
 int sys_ipc_try_send(u_int envid, u_int value, u_int srcva, u_int perm)
 {
 	struct Env *e;
-	struct Page *p;
 
 	/* Step 1: Check if 'srcva' is either zero or a legal address. */
 	/* Exercise 4.8: Your code here. (4/8) */
@@ -453,37 +1129,122 @@ int sys_ipc_try_send(u_int envid, u_int value, u_int srcva, u_int perm)
 
 	/* Step 3: Check if the target is waiting for a message. */
 	/* Exercise 4.8: Your code here. (6/8) */
-	if (e->env_ipc_recving == 0)
+	if (!ipc_can_send(curenv, e))
 	{
 		return -E_IPC_NOT_RECV;
 	}
+	return ipc_deliver(e, value, srcva, perm);
+}
 
-	/* Step 4: Set the target's ipc fields. */
-	e->env_ipc_value = value;
-	e->env_ipc_from = curenv->env_id;
-	e->env_ipc_perm = PTE_V | perm;
-	e->env_ipc_recving = 0;
+/* Overview:
+ *   Check that a message with the page at 'srcva' (if not 0) can be queued for 'e', before
+ *   blocking in 'ipc_block_send'.
+ *
+ * Post-Condition:
+ *   Return 0 if so, -E_IPC_NOT_RECV if 'e' is 'curenv', which would wait for itself forever,
+ *   -E_INVAL if 'srcva' is not mapped in 'curenv', or the original error when underlying calls
+ *   fail.
+ */
+static int ipc_check_block(struct Env *e, u_int srcva, u_int perm)
+{
+	struct Page *p;
 
-	/* Step 5: Set the target's status to 'ENV_RUNNABLE' again and insert it to the tail of
-	 * 'env_sched_list'. */
-	/* Exercise 4.8: Your code here. (7/8) */
-	e->env_status = ENV_RUNNABLE;
-	TAILQ_INSERT_TAIL(&env_sched_list, e, env_sched_link);
+	if (e == curenv)
+	{
+		return -E_IPC_NOT_RECV;
+	}
+	return ipc_lookup(curenv, srcva, perm, &p);
+}
 
-	/* Step 6: If 'srcva' is not zero, map the page at 'srcva' in 'curenv' to 'e->env_ipc_dstva'
-	 * in 'e'. */
-	/* Return -E_INVAL if 'srcva' is not zero and not mapped in 'curenv'. */
-	if (srcva != 0)
+/* Overview:
+ *   Send a 'value' (together with a page if 'srcva' is not 0) to 'envid', as 'sys_ipc_try_send',
+ *   but if it's not waiting for a message from us, block until it takes ours in 'sys_ipc_recv'
+ *   instead of failing.
+ *
+ * Post-Condition:
+ *   Return 0 once the message is received.
+ *   Return -E_INVAL if 'srcva' is neither 0 nor a legal address, -E_BAD_ENV if 'envid' doesn't
+ *   exist or is freed before receiving the message, -E_IPC_NOT_RECV if 'envid' is 'curenv' and
+ *   not receiving, or the original error when underlying calls fail.
+ */
+int sys_ipc_send(u_int envid, u_int value, u_int srcva, u_int perm)
+{
+	struct Env *e;
+
+	if (srcva != 0 && is_illegal_va(srcva))
 	{
-		/* Exercise 4.8: Your code here. (8/8) */
-		p = page_lookup(curenv->env_pgdir, srcva, NULL);
-		if (p == NULL)
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 0));
+	if (ipc_can_send(curenv, e))
+	{
+		return ipc_deliver(e, value, srcva, perm);
+	}
+	try(ipc_check_block(e, srcva, perm));
+	ipc_block_send(e, value, srcva, perm);
+}
+
+/* Overview:
+ *   Send a request ('value', together with the page at 'srcva' if not 0) to 'envid', and wait
+ *   for its reply (received at 'dstva' if not 0) in the same syscall: 'sys_ipc_send' followed
+ *   by 'sys_ipc_recv', but no other env can send to us in between, or before 'envid' replies.
+ *
+ * Post-Condition:
+ *   Return 0 once the reply is received, as 'sys_ipc_recv'.
+ *   Return -E_INVAL if 'srcva' or 'dstva' is neither 0 nor a legal address, or the errors of
+ *   'sys_ipc_send'. The request is not sent then.
+ *   Return -E_BAD_ENV if 'envid' is freed after taking the request, before replying.
+ */
+int sys_ipc_call(u_int envid, u_int value, u_int srcva, u_int perm, u_int dstva)
+{
+	struct Env *e;
+
+	if ((srcva != 0 && is_illegal_va(srcva)) || (dstva != 0 && is_illegal_va(dstva)))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 0));
+	if (ipc_can_send(curenv, e))
+	{
+		try(ipc_deliver(e, value, srcva, perm));
+		curenv->env_ipc_callee = e->env_id;
+		return ipc_wait(dstva);
+	}
+	try(ipc_check_block(e, srcva, perm));
+	curenv->env_ipc_callee = e->env_id;
+	curenv->env_ipc_dstva = dstva;
+	ipc_block_send(e, value, srcva, perm);
+}
+
+/* Overview:
+ *   The server side of 'sys_ipc_call': send the reply ('value', together with the page at
+ *   'srcva' if not 0) to 'envid', unless it's 0, and wait for the next request (received at
+ *   'dstva' if not 0) in the same syscall.
+ *
+ * Post-Condition:
+ *   Return 0 once the next request is received, as 'sys_ipc_recv'.
+ *   Return -E_INVAL if 'srcva' or 'dstva' is neither 0 nor a legal address, -E_IPC_NOT_RECV if
+ *   'envid' is not waiting for a message from us, or the original error when underlying calls
+ *   fail. We don't wait then.
+ */
+int sys_ipc_reply_and_recv(u_int envid, u_int value, u_int srcva, u_int perm, u_int dstva)
+{
+	struct Env *e;
+
+	if ((srcva != 0 && is_illegal_va(srcva)) || (dstva != 0 && is_illegal_va(dstva)))
+	{
+		return -E_INVAL;
+	}
+	if (envid != 0)
+	{
+		try(envid2env(envid, &e, 0));
+		if (!ipc_can_send(curenv, e))
 		{
-			return -E_INVAL;
+			return -E_IPC_NOT_RECV;
 		}
-		try(page_insert(e->env_pgdir, e->env_asid, p, e->env_ipc_dstva, perm));
+		try(ipc_deliver(e, value, srcva, perm));
 	}
-	return 0;
+	return ipc_wait(dstva);
 }
 
 // XXX: kernel does busy waiting here, blocking all envs
@@ -679,6 +1440,308 @@ u_int sys_get_parent_id(u_int envid)
 	return e->env_parent_id;
 }
 
+/* Overview:
+ *   Copy the statistics of at most 'n' kernel object caches into the user buffer 'buf'.
+ *
+ * Post-Condition:
+ *   Return the total number of caches, which may be larger than 'n'.
+ *   Return -E_INVAL if 'buf' is not a valid user buffer.
+ */
+int sys_kmem_info(struct Kmem_info *buf, u_int n)
+{
+	if (n > PAGE_SIZE / sizeof(struct Kmem_info) ||
+	    is_illegal_va_range((u_long)buf, n * sizeof(struct Kmem_info)))
+	{
+		return -E_INVAL;
+	}
+	return kmem_info(buf, n);
+}
+
+/* Overview:
+ *   Copy the swap statistics into the user buffer 'buf'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_INVAL if 'buf' is not a valid user buffer.
+ */
+int sys_swap_info(struct Swap_info *buf)
+{
+	if (is_illegal_va_range((u_long)buf, sizeof *buf))
+	{
+		return -E_INVAL;
+	}
+	*buf = swap_stat;
+	return 0;
+}
+
+/* Overview:
+ *   Set the rate of the KSM scanner to 'rate' pages per clock tick (0 stops it, and rates above
+ *   'KSM_MAX_RATE' are capped), unless 'rate' is negative. Then copy the KSM statistics into the
+ *   user buffer 'buf', unless it's NULL.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_INVAL if 'buf' is not a valid user buffer.
+ */
+int sys_ksm_ctl(int rate, struct Ksm_info *buf)
+{
+	if (buf != NULL && is_illegal_va_range((u_long)buf, sizeof *buf))
+	{
+		return -E_INVAL;
+	}
+	if (rate >= 0)
+	{
+		ksm_set_rate(rate);
+	}
+	if (buf != NULL)
+	{
+		*buf = ksm_stat;
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Copy the memory statistics of env 'envid' (any env, not only our children) and the number of
+ *   free and total physical pages into the user buffer 'buf'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_BAD_ENV if 'envid' is not a live env, or -E_INVAL if 'buf' is not a
+ *   valid user buffer.
+ */
+int sys_mem_stat(u_int envid, struct Mem_stat *buf)
+{
+	struct Env_mem em;
+	struct Env *e;
+
+	if (is_illegal_va_range((u_long)buf, sizeof *buf))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 0));
+	/* Writing to 'buf' may copy one of our page tables, so count before. */
+	em = e->env_mem;
+	pgdir_account_shared(e->env_pgdir, &em);
+	buf->ms_env = em;
+	buf->ms_free = page_free_count();
+	buf->ms_total = npage;
+	return 0;
+}
+
+/* Overview:
+ *   Copy the syscall statistics of 'envid' and of all envs, counts, cycles and latency
+ *   histograms, into the user buffer 'buf'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_INVAL if 'buf' is not a valid user buffer, -E_NO_SYS if the kernel
+ *   was built without them ('MOS_SYSSTAT=n'), or the original error if 'envid2env' fails.
+ */
+int sys_sysstat(u_int envid, struct Sysstat *buf)
+{
+	struct Env *e;
+
+	if (is_illegal_va_range((u_long)buf, sizeof *buf))
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 0));
+	return sysstat_get(e, buf);
+}
+
+/* Overview:
+ *   Set the base run queue level of 'envid' to 'level'. Runnable envs at a higher level always
+ *   run before those at a lower one.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_INVAL if 'level' is not less than 'SCHED_NLEVELS', or the original
+ *   error if 'envid2env' fails. If a higher level than ours became runnable, we are preempted on
+ *   the way out of the syscall.
+ */
+int sys_set_priority(u_int envid, u_int level)
+{
+	struct Env *e;
+
+	if (level >= SCHED_NLEVELS)
+	{
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 1));
+	sched_set_level(e, level);
+	return 0;
+}
+
+/* Overview:
+ *   Block 'curenv' for at least 'cycles' cycles of CP0_COUNT ('KCLOCK_HZ' per second). It's off
+ *   the run queues until then. Sleeping 0 cycles just yields.
+ *
+ * Post-Condition:
+ *   Return 0 when woken up.
+ *
+ * Hint:
+ *   This function will never return.
+ */
+void __attribute__((noreturn)) sys_sleep(u_int cycles)
+{
+	cur_tf->regs[2] = 0;
+	if (cycles == 0)
+	{
+		schedule(1);
+	}
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	sched_remove(curenv);
+	timer_add(curenv, kclock_now() + cycles);
+	schedule(1);
+}
+
+/* Overview:
+ *   Store the number of CP0_COUNT cycles since boot into '*buf'. The time never goes backwards.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_INVAL if 'buf' is not a valid user buffer.
+ */
+int sys_gettime(uint64_t *buf)
+{
+	if (is_illegal_va_range((u_long)buf, sizeof *buf))
+	{
+		return -E_INVAL;
+	}
+	*buf = kclock_now();
+	return 0;
+}
+
+/* Overview:
+ *   Find the physical address of the futex word at 'va' in 'curenv'. A copy-on-write page is
+ *   copied first, as the word will be written.
+ */
+static int futex_key(u_int va, u_long *key)
+{
+	struct Page *pp;
+
+	if (va % 4 != 0 || is_illegal_va(va))
+	{
+		return -E_INVAL;
+	}
+	try(lookup_for_map(curenv, va, PTE_D, &pp));
+	*key = page2pa(pp) + (va & (PAGE_SIZE - 1));
+	return 0;
+}
+
+/* Overview:
+ *   Block 'curenv' on the word at 'va' if it still holds 'expected', until 'sys_futex_wake' is
+ *   called on the same word, from any address it's mapped at in any env. Checking the word and
+ *   blocking can't be interrupted, so no wake-up is lost in between.
+ *
+ * Post-Condition:
+ *   Return 0 when woken up, -E_AGAIN if the word doesn't hold 'expected', -E_INVAL if 'va' is
+ *   not an aligned and mapped user address, or -E_NO_MEM if we're out of memory.
+ */
+int sys_futex_wait(u_int va, u_int expected)
+{
+	u_long key;
+
+	try(futex_key(va, &key));
+	if (*(u_int *)KADDR(key) != expected)
+	{
+		return -E_AGAIN;
+	}
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	sched_remove(curenv);
+	futex_block(curenv, key);
+	cur_tf->regs[2] = 0;
+	schedule(1);
+}
+
+/* Overview:
+ *   Wake up to 'n' envs blocked on the word at 'va', those waiting longest first.
+ *
+ * Post-Condition:
+ *   Return the number of envs woken up, or the error of finding the word, as in
+ *   'sys_futex_wait'.
+ */
+int sys_futex_wake(u_int va, u_int n)
+{
+	u_long key;
+
+	try(futex_key(va, &key));
+	return futex_wake(key, n);
+}
+
+extern void *syscall_table[MAX_SYSNO];
+
+/* Overview:
+ *   Return whether the syscall described by 'mc' may be run by 'sys_multicall'. Syscalls which
+ *   block, switch envs or replace the trapframe of 'curenv' don't return to the batch, and those
+ *   without a result can't tell whether they failed. 'sys_set_env_status' and 'sys_env_destroy'
+ *   switch envs only when applied to 'curenv', so they may be batched, and fail themselves if
+ *   they are (see 'in_multicall').
+ */
+static int multicall_allowed(struct Multicall *mc)
+{
+	switch (mc->mc_sysno)
+	{
+	case SYS_putchar:
+	case SYS_yield:
+	case SYS_exofork:
+	case SYS_fork:
+	case SYS_spawn:
+	case SYS_set_trapframe:
+	case SYS_panic:
+	case SYS_ipc_recv:
+	case SYS_ipc_send:
+	case SYS_ipc_call:
+	case SYS_ipc_reply_and_recv:
+	case SYS_cgetc:
+	case SYS_sleep:
+	case SYS_futex_wait:
+	case SYS_multicall:
+		return 0;
+	default:
+		return mc->mc_sysno < MAX_SYSNO;
+	}
+}
+
+/* Overview:
+ *   Run the 'n' syscalls described by 'calls' one after another in a single trap, storing the
+ *   result of each in its 'mc_result'. Stop at the first one which fails.
+ *   Each syscall is counted in the statistics (see 'sysstat_fast') on its own, as well as the
+ *   whole batch under 'SYS_multicall'.
+ *
+ * Post-Condition:
+ *   Return the number of syscalls which succeeded, 'n' if all of them did. If it's less than
+ *   'n', the next one failed, with its error in its 'mc_result' (-E_INVAL if it may not be
+ *   batched), and the rest were not run.
+ *   Return -E_INVAL if 'n' is larger than 'MULTICALL_MAX' or 'calls' is not a legal address.
+ */
+int sys_multicall(struct Multicall *calls, u_int n)
+{
+	int (*func)(u_int, u_int, u_int, u_int, u_int);
+	struct Multicall *mc;
+	u_int i, start;
+
+	if (n > MULTICALL_MAX || is_illegal_va_range((u_long)calls, n * sizeof *calls))
+	{
+		return -E_INVAL;
+	}
+	in_multicall = 1;
+	for (i = 0; i < n; i++)
+	{
+		mc = &calls[i];
+		if (!multicall_allowed(mc))
+		{
+			mc->mc_result = -E_INVAL;
+			break;
+		}
+		func = syscall_table[mc->mc_sysno];
+		start = (u_int)kclock_now();
+		mc->mc_result = func(mc->mc_args[0], mc->mc_args[1], mc->mc_args[2], mc->mc_args[3],
+				     mc->mc_args[4]);
+		sysstat_fast(mc->mc_sysno, start);
+		if (mc->mc_result < 0)
+		{
+			break;
+		}
+	}
+	in_multicall = 0;
+	return i;
+}
+
 void *syscall_table[MAX_SYSNO] = {
 	[SYS_putchar] = sys_putchar,
 	[SYS_print_cons] = sys_print_cons,
@@ -706,6 +1769,40 @@ void *syscall_table[MAX_SYSNO] = {
 	[SYS_get_var] = sys_get_var,
 	[SYS_get_all_var] = sys_get_all_var,
 	[SYS_get_parent_id] = sys_get_parent_id,
+	[SYS_kmem_info] = sys_kmem_info,
+	[SYS_swap_info] = sys_swap_info,
+	[SYS_ksm_ctl] = sys_ksm_ctl,
+	[SYS_mem_stat] = sys_mem_stat,
+	[SYS_set_priority] = sys_set_priority,
+	[SYS_sleep] = sys_sleep,
+	[SYS_gettime] = sys_gettime,
+	[SYS_futex_wait] = sys_futex_wait,
+	[SYS_futex_wake] = sys_futex_wake,
+	[SYS_multicall] = sys_multicall,
+	[SYS_mem_alloc_range] = sys_mem_alloc_range,
+	[SYS_mem_map_range] = sys_mem_map_range,
+	[SYS_mem_unmap_range] = sys_mem_unmap_range,
+	[SYS_fork] = sys_fork,
+	[SYS_spawn] = sys_spawn,
+	[SYS_sysstat] = sys_sysstat,
+	[SYS_ipc_call] = sys_ipc_call,
+	[SYS_ipc_reply_and_recv] = sys_ipc_reply_and_recv,
+	[SYS_ipc_send] = sys_ipc_send,
+};
+
+/*
+ * Syscalls which take at most 3 arguments and neither block nor switch envs, called without
+ * saving the full trapframe (see 'fast_syscall' in kern/entry.S).
+ */
+_Static_assert(MAX_SYSNO <= SYSCALL_FAST_LIMIT, "SYSCALL_FAST_LIMIT is too small");
+void *syscall_fast_table[SYSCALL_FAST_LIMIT] = {
+	[SYS_putchar] = sys_putchar,
+	[SYS_print_cons] = sys_print_cons,
+	[SYS_getenvid] = sys_getenvid,
+	[SYS_write_dev] = sys_write_dev,
+	[SYS_read_dev] = sys_read_dev,
+	[SYS_get_parent_id] = sys_get_parent_id,
+	[SYS_gettime] = sys_gettime,
 };
 
 /* Overview:
@@ -728,6 +1825,8 @@ void do_syscall(struct Trapframe *tf)
 		return;
 	}
 
+	sysstat_begin(sysno);
+
 	/* Step 1: Add the EPC in 'tf' by a word (size of an instruction). */
 	/* Exercise 4.2: Your code here. (1/4) */
 	tf->cp0_epc += 4;
@@ -751,4 +1850,13 @@ void do_syscall(struct Trapframe *tf)
 	 */
 	/* Exercise 4.2: Your code here. (4/4) */
 	tf->regs[2] = func(arg1, arg2, arg3, arg4, arg5);
+	sysstat_end();
+
+	/* Step 6: Switch now if the syscall made an env at a higher level runnable. A sender of an
+	 * IPC message is not preempted by its receiver, as it usually blocks receiving right away,
+	 * handing the CPU over (see 'sys_ipc_recv'). */
+	if (sysno != SYS_ipc_try_send && sysno != SYS_ipc_send && sched_need_preempt())
+	{
+		schedule(0);
+	}
 }
@@ -0,0 +1,134 @@
+#include <env.h>
+#include <kclock.h>
+#include <kmem.h>
+#include <sysstat.h>
+
+static struct Sysstat_call sysstat_all[MAX_SYSNO];
+static u_int sysstat_hist[MAX_SYSNO][SYSSTAT_NBUCKETS];
+
+// The statistics of an env ('env_sysstat'), allocated on its first syscall. The histogram of
+// each syscall is allocated on its first call, as an env makes few of them.
+struct Sysstat_env {
+	struct Sysstat_call se_calls[MAX_SYSNO];
+	u_int *se_hist[MAX_SYSNO];
+};
+
+static struct Kmem_cache sysstat_cache =
+    KMEM_CACHE_INITIALIZER("sysstat", sizeof(struct Sysstat_env));
+static struct Kmem_cache sysstat_hist_cache =
+    KMEM_CACHE_INITIALIZER("sysstat_hist", sizeof(u_int) * SYSSTAT_NBUCKETS);
+
+// The syscall in progress, if 'sc_sysno' is less than 'MAX_SYSNO'. 'sc_env' is the
+// env which made it, or NULL if that one has been freed since.
+static struct Sysstat_cur {
+	struct Env *sc_env;
+	u_int sc_sysno;
+	u_int sc_start; // CP0_COUNT at its trap
+} sysstat_cur = {.sc_sysno = MAX_SYSNO};
+
+static void sysstat_record(struct Env *e, u_int sysno, u_int cycles) {
+	u_int bucket = cycles == 0 ? 0 : 31 - __builtin_clz(cycles);
+	struct Sysstat_env *se;
+
+	bucket = MIN(bucket, SYSSTAT_NBUCKETS - 1);
+	sysstat_all[sysno].sc_count++;
+	sysstat_all[sysno].sc_cycles += cycles;
+	sysstat_hist[sysno][bucket]++;
+	if (e == NULL) {
+		return;
+	}
+	if ((se = e->env_sysstat) == NULL) {
+		if ((se = kmem_cache_alloc(&sysstat_cache)) == NULL) {
+			return;
+		}
+		memset(se, 0, sizeof *se);
+		e->env_sysstat = se;
+	}
+	se->se_calls[sysno].sc_count++;
+	se->se_calls[sysno].sc_cycles += cycles;
+	if (se->se_hist[sysno] == NULL) {
+		if ((se->se_hist[sysno] = kmem_cache_alloc(&sysstat_hist_cache)) == NULL) {
+			return;
+		}
+		memset(se->se_hist[sysno], 0, sizeof(u_int) * SYSSTAT_NBUCKETS);
+	}
+	se->se_hist[sysno][bucket]++;
+}
+
+/* Overview:
+ *   Start timing the syscall 'sysno' of 'curenv', trapped on the full path ('do_syscall').
+ */
+void sysstat_begin(u_int sysno) {
+	struct Sysstat_cur *cur = &sysstat_cur;
+
+	cur->sc_env = curenv;
+	cur->sc_sysno = sysno;
+	cur->sc_start = (u_int)kclock_now();
+}
+
+/* Overview:
+ *   End the syscall in progress, if any. Called when it returns, and whenever the
+ *   kernel returns to user mode or goes idle, as a syscall may switch envs instead.
+ */
+void sysstat_end(void) {
+	struct Sysstat_cur *cur = &sysstat_cur;
+
+	if (cur->sc_sysno < MAX_SYSNO) {
+		sysstat_record(cur->sc_env, cur->sc_sysno, (u_int)kclock_now() - cur->sc_start);
+		cur->sc_sysno = MAX_SYSNO;
+	}
+}
+
+/* Overview:
+ *   Count a syscall of 'curenv' timed apart from 'do_syscall', started when CP0_COUNT was
+ *   'start': one which took the fast path (see 'fast_syscall' in kern/entry.S), or one run in a
+ *   batch by 'sys_multicall'.
+ */
+void sysstat_fast(u_int sysno, u_int start) {
+	sysstat_record(curenv, sysno, (u_int)kclock_now() - start);
+}
+
+/* Overview:
+ *   Free the statistics of 'e', which is being freed. A syscall of it in progress is still
+ *   counted for all envs.
+ */
+void sysstat_forget(struct Env *e) {
+	struct Sysstat_env *se = e->env_sysstat;
+
+	if (se != NULL) {
+		for (int i = 0; i < MAX_SYSNO; i++) {
+			if (se->se_hist[i] != NULL) {
+				kmem_cache_free(&sysstat_hist_cache, se->se_hist[i]);
+			}
+		}
+		kmem_cache_free(&sysstat_cache, se);
+		e->env_sysstat = NULL;
+	}
+	if (sysstat_cur.sc_env == e) {
+		sysstat_cur.sc_env = NULL;
+	}
+}
+
+/* Overview:
+ *   Copy the statistics of 'e' and of all envs into 'buf'.
+ *
+ * Post-Condition:
+ *   Return 0.
+ */
+int sysstat_get(struct Env *e, struct Sysstat *buf) {
+	struct Sysstat_env *se = e->env_sysstat;
+
+	memset(buf->ss_env, 0, sizeof buf->ss_env);
+	memset(buf->ss_env_hist, 0, sizeof buf->ss_env_hist);
+	if (se != NULL) {
+		memcpy(buf->ss_env, se->se_calls, sizeof buf->ss_env);
+		for (int i = 0; i < MAX_SYSNO; i++) {
+			if (se->se_hist[i] != NULL) {
+				memcpy(buf->ss_env_hist[i], se->se_hist[i], sizeof buf->ss_env_hist[i]);
+			}
+		}
+	}
+	memcpy(buf->ss_all, sysstat_all, sizeof buf->ss_all);
+	memcpy(buf->ss_hist, sysstat_hist, sizeof buf->ss_hist);
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include <env.h>
+#include <kclock.h>
+#include <sched.h>
+#include <timer.h>
+
+#define TIMER_SLOT(t) ((u_int)((t) >> TIMER_WHEEL_SHIFT) % TIMER_WHEEL_SIZE)
+
+static struct Env_list timer_wheel[TIMER_WHEEL_SIZE];
+static u_int timer_count; // number of sleeping envs
+static uint64_t timer_done; // all timers due before this have fired
+
+void timer_init(void) {
+	for (int i = 0; i < TIMER_WHEEL_SIZE; i++) {
+		LIST_INIT(&timer_wheel[i]);
+	}
+	timer_count = 0;
+}
+
+/* Overview:
+ *   Wake 'e' up at CP0_COUNT cycle 'when'. 'e' must not be runnable until then.
+ */
+void timer_add(struct Env *e, uint64_t when) {
+	timer_cancel(e);
+	e->env_wakeup = when;
+	LIST_INSERT_HEAD(&timer_wheel[TIMER_SLOT(when)], e, env_timer_link);
+	timer_count++;
+}
+
+/* Overview:
+ *   Remove the timer of 'e', if any.
+ */
+void timer_cancel(struct Env *e) {
+	if (e->env_wakeup == 0) {
+		return;
+	}
+	LIST_REMOVE(e, env_timer_link);
+	e->env_wakeup = 0;
+	timer_count--;
+}
+
+/* Overview:
+ *   Make every env whose wake-up time is not after 'now' runnable.
+ *   Only the slots passed since the last call are visited, or the whole wheel if it turned
+ *   around since then.
+ */
+void timer_run(uint64_t now) {
+	struct Env *e, *next;
+	uint64_t passed = (now >> TIMER_WHEEL_SHIFT) - (timer_done >> TIMER_WHEEL_SHIFT);
+	u_int slot = TIMER_SLOT(timer_done);
+
+	for (u_int n = MIN(passed + 1, (uint64_t)TIMER_WHEEL_SIZE); timer_count > 0 && n > 0; n--) {
+		for (e = LIST_FIRST(&timer_wheel[slot]); e != NULL; e = next) {
+			next = LIST_NEXT(e, env_timer_link);
+			if (e->env_wakeup <= now) {
+				timer_cancel(e);
+				e->env_status = ENV_RUNNABLE;
+				sched_insert(e, 0);
+			}
+		}
+		slot = (slot + 1) % TIMER_WHEEL_SIZE;
+	}
+	timer_done = now;
+}
+
+/* Overview:
+ *   Return the earliest wake-up time, or 'KCLOCK_NEVER' if no env is sleeping.
+ *   The first slot (from the current one on) holding a timer of its current turn has the
+ *   earliest one; only if there's none, every timer is looked at.
+ */
+uint64_t timer_next(void) {
+	struct Env *e;
+	uint64_t next = KCLOCK_NEVER, end;
+	u_int slot = TIMER_SLOT(timer_done);
+
+	if (timer_count == 0) {
+		return KCLOCK_NEVER;
+	}
+	end = ((timer_done >> TIMER_WHEEL_SHIFT) + 1) << TIMER_WHEEL_SHIFT;
+	for (int n = 0; n < TIMER_WHEEL_SIZE; n++) {
+		LIST_FOREACH (e, &timer_wheel[slot], env_timer_link) {
+			if (e->env_wakeup < end) {
+				next = MIN(next, e->env_wakeup);
+			}
+		}
+		if (next != KCLOCK_NEVER) {
+			return next;
+		}
+		slot = (slot + 1) % TIMER_WHEEL_SIZE;
+		end += 1 << TIMER_WHEEL_SHIFT;
+	}
+	for (slot = 0; slot < TIMER_WHEEL_SIZE; slot++) {
+		LIST_FOREACH (e, &timer_wheel[slot], env_timer_link) {
+			next = MIN(next, e->env_wakeup);
+		}
+	}
+	return next;
+}
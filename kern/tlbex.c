@@ -1,6 +1,15 @@
+#include <asm/cp0regdef.h>
 #include <bitops.h>
 #include <env.h>
+#include <error.h>
 #include <pmap.h>
+#include <string.h>
+#include <swap.h>
+
+/* Pending invalidations of 'tlb_batch_asid', between 'tlb_batch_lo' and 'tlb_batch_hi'. */
+static int tlb_batching;
+static u_int tlb_batch_asid;
+static u_long tlb_batch_lo, tlb_batch_hi;
 
 /* Lab 2 Key Code "tlb_invalidate" */
 /* Overview:
@@ -11,11 +20,65 @@
  *   'tlb_out' is defined in mm/tlb_asm.S
  */
 void tlb_invalidate(u_int asid, u_long va) {
+	if (tlb_batching && asid == tlb_batch_asid) {
+		tlb_batch_lo = MIN(tlb_batch_lo, va);
+		tlb_batch_hi = MAX(tlb_batch_hi, va);
+		return;
+	}
 	tlb_out((va & ~GENMASK(PGSHIFT, 0)) | (asid & (NASID - 1)));
 }
 /* End of Key Code "tlb_invalidate" */
 
-static void passive_alloc(u_int va, Pde *pgdir, u_int asid) {
+/* Overview:
+ *   Defer the invalidations of 'asid' until 'tlb_batch_end', for syscalls changing the mappings
+ *   of many pages. Only the range they span is remembered.
+ *
+ * Pre-Condition:
+ *   No address in that range is accessed through the TLB until 'tlb_batch_end'.
+ */
+void tlb_batch_begin(u_int asid) {
+	tlb_batching = 1;
+	tlb_batch_asid = asid;
+	tlb_batch_lo = ~0UL;
+	tlb_batch_hi = 0;
+}
+
+/* Overview:
+ *   Invalidate the entries deferred since 'tlb_batch_begin': each entry maps a pair of pages, so
+ *   probe once per pair, or drop every entry of the ASID if the range has more pairs than
+ *   'TLB_FLUSH_PAIRS'.
+ */
+void tlb_batch_end(void) {
+	u_long va;
+
+	tlb_batching = 0;
+	if (tlb_batch_lo > tlb_batch_hi) {
+		return;
+	}
+	if ((tlb_batch_hi - tlb_batch_lo) >> (PGSHIFT + 1) >= TLB_FLUSH_PAIRS) {
+		tlb_flush_asid(tlb_batch_asid);
+		return;
+	}
+	for (va = tlb_batch_lo & ~GENMASK(PGSHIFT, 0); va <= tlb_batch_hi; va += 2 * PAGE_SIZE) {
+		tlb_out(va | (tlb_batch_asid & (NASID - 1)));
+	}
+}
+
+// Exception code of the exception being handled, e.g. 'EXC_TLBL' for a TLB miss on a load.
+static inline u_int exc_code(void) {
+	u_int cause;
+
+	asm volatile("mfc0 %0, $13" : "=r"(cause)); // CP0_CAUSE
+	return (cause >> 2) & 0x1f;
+}
+
+/* Overview:
+ *   Map a page at 'va', which is neither mapped nor swapped out.
+ *   A read of user memory maps the shared zero page read-only with 'PTE_COW', so untouched
+ *   memory which is only read costs no page; the first write copies it in 'do_tlb_mod'.
+ *   Writes (and the page table area) get a private page at once.
+ */
+static void passive_alloc(u_int va, Pde *pgdir, u_int asid, int write) {
 	struct Page *p = NULL;
 
 	if (va < UTEMP) {
@@ -38,6 +101,12 @@ static void passive_alloc(u_int va, Pde *pgdir, u_int asid) {
 		panic("kernel address");
 	}
 
+	if (!write && va < UVPT && zero_page->pp_ref < ZERO_PAGE_MAX_REF) {
+		panic_on(page_insert(pgdir, asid, zero_page, PTE_ADDR(va), PTE_COW));
+		return;
+	}
+
+	swap_balance();
 	panic_on(page_alloc(&p));
 	panic_on(page_insert(pgdir, asid, p, PTE_ADDR(va), (va >= UVPT && va < ULIM) ? 0 : PTE_D));
 }
@@ -59,15 +128,63 @@ void _do_tlb_refill(u_long *pentrylo, u_int va, u_int asid) {
 	/* Exercise 2.9: Your code here. */
 	while (page_lookup(cur_pgdir, va, &ppte) == NULL)
 	{
-		passive_alloc(va, cur_pgdir, asid);
+		/* A swapped out page is read back, any other missing page is allocated. */
+		int r = swap_in(cur_pgdir, asid, va);
+		if (r < 0) {
+			panic("cannot swap in %x: %d", va, r);
+		}
+		if (r == 0) {
+			passive_alloc(va, cur_pgdir, asid, exc_code() != EXC_TLBL);
+		}
 	}
+	/* Tell the CLOCK scan of 'swap_out' that this page is in use. */
+	*ppte |= PTE_REF;
 
 	ppte = (Pte *)((u_long)ppte & ~0x7);
 	pentrylo[0] = ppte[0] >> 6;
 	pentrylo[1] = ppte[1] >> 6;
+	/* A page table shared by 'fork' is read-only until it's copied in 'do_tlb_mod'. */
+	if (pgtable_shared(cur_pgdir, va)) {
+		pentrylo[0] &= ~(PTE_D >> 6);
+		pentrylo[1] &= ~(PTE_D >> 6);
+	}
 }
 
 #if !defined(LAB) || LAB >= 4
+/* Overview:
+ *   Give 'va' in 'pgdir' a private, writable copy of its copy-on-write page.
+ *   The last reference to a page needs no copy, its mapping is just made writable.
+ *
+ * Post-Condition:
+ *   Return 0 on success, -E_INVAL if 'va' is not mapped copy-on-write, or -E_NO_MEM if we're out
+ *   of memory.
+ */
+int cow_break(Pde *pgdir, u_int asid, u_long va) {
+	struct Page *pp, *np;
+	Pte *pte;
+
+	try(pgtable_unshare(pgdir, asid, va));
+	if ((pp = page_lookup(pgdir, va, &pte)) == NULL || !(*pte & PTE_COW)) {
+		return -E_INVAL;
+	}
+	if (pp->pp_ref == 1) {
+		page_account(pgdir, asid, pp, va, *pte, -1);
+		*pte = (*pte & ~PTE_COW) | PTE_D;
+		page_account(pgdir, asid, pp, va, *pte, 1);
+		tlb_invalidate(asid, va);
+		return 0;
+	}
+	try(page_alloc(&np));
+	if (pp != zero_page) {
+		memcpy((void *)page2kva(np), (void *)page2kva(pp), PAGE_SIZE);
+	}
+	if (page_insert(pgdir, asid, np, va, (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_D) != 0) {
+		page_free(np);
+		return -E_NO_MEM;
+	}
+	return 0;
+}
+
 /* Overview:
  *   This is the TLB Mod exception handler in kernel.
  *   Our kernel allows user programs to handle TLB Mod exception in user mode, so we copy its
@@ -81,13 +198,39 @@ void _do_tlb_refill(u_long *pentrylo, u_int va, u_int asid) {
  */
 void do_tlb_mod(struct Trapframe *tf) {
 	struct Trapframe tmp_tf = *tf;
+	Pte *pte;
+
+	/* A write through a page table shared by 'fork' gets a private copy of the table first.
+	 * Its entry is then either writable, in which case the TLB entry was loaded while the table
+	 * was shared and is just dropped, or handled below like any other. */
+	if (pgtable_unshare(cur_pgdir, curenv->env_asid, tf->cp0_badvaddr) < 0) {
+		panic("cannot copy the page table of %x", tf->cp0_badvaddr);
+	}
+	if (page_lookup(cur_pgdir, tf->cp0_badvaddr, &pte) != NULL && (*pte & PTE_D)) {
+		tlb_invalidate(curenv->env_asid, tf->cp0_badvaddr);
+		return;
+	}
+
+	/* Copy-on-write pages are copied here when there's no user handler to do it (e.g. pages
+	 * merged by the KSM scanner in an env which never forked), and when the kernel itself writes
+	 * to user memory, since the user handler cannot be run from kernel mode. The zero page is
+	 * always handled here: the copy is just a fresh page. */
+	if (!curenv->env_user_tlb_mod_entry || !(tf->cp0_status & STATUS_UM) ||
+	    page_lookup(cur_pgdir, tf->cp0_badvaddr, &pte) == zero_page) {
+		int r = cow_break(cur_pgdir, curenv->env_asid, tf->cp0_badvaddr);
+		if (r == 0) {
+			return;
+		}
+		if (r == -E_NO_MEM) {
+			panic("cannot copy the copy-on-write page at %x", tf->cp0_badvaddr);
+		}
+	}
 
 	if (tf->regs[29] < USTACKTOP || tf->regs[29] >= UXSTACKTOP) {
 		tf->regs[29] = UXSTACKTOP;
 	}
 	tf->regs[29] -= sizeof(struct Trapframe);
 	*(struct Trapframe *)tf->regs[29] = tmp_tf;
-	Pte *pte;
 	page_lookup(cur_pgdir, tf->cp0_badvaddr, &pte);
 	if (curenv->env_user_tlb_mod_entry) {
 		tf->regs[4] = tf->regs[29];
@@ -1,3 +1,16 @@
+# Scheduling policy of the kernel: 'MOS_SCHED=cfs' selects the fair-share scheduler of
+# kern/sched_cfs.c instead of the priority run queues of kern/sched.c. Run 'make clean' when
+# switching.
+ifeq ($(MOS_SCHED),cfs)
+	CFLAGS   += -DMOS_SCHED_CFS
+endif
+
+# Syscall statistics (see include/sysstat.h): 'MOS_SYSSTAT=n' compiles them out of the kernel.
+# Run 'make clean' when changing.
+ifeq ($(MOS_SYSSTAT),n)
+	CFLAGS   += -DMOS_NO_SYSSTAT
+endif
+
 RELEASE_CFLAGS   := $(CFLAGS) -O2
 RELEASE_LDFLAGS  := $(LDFLAGS) -O --gc-sections
 DEBUG_CFLAGS     := $(CFLAGS) -O0 -g -ggdb -DMOS_DEBUG
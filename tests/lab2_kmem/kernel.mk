@@ -0,0 +1 @@
+init-override := $(test_dir)/init.c
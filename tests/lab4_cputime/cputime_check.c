@@ -0,0 +1,68 @@
+// CPU time check: busy loops are charged as user time, syscalls as kernel time, sleeping as
+// neither, and the times of a dead child are added to its parent.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+int main() {
+	uint64_t u, k, t, d;
+	u_int who;
+	int child;
+
+	// Spin for 50 ms in user mode.
+	u = env->env_utime;
+	t = now();
+	while (now() - t < 50 * MS) {
+		for (volatile int i = 0; i < 10000; i++) {
+		}
+	}
+	d = env->env_utime - u;
+	if (d < 30 * MS || d > 60 * MS) {
+		user_panic("50 ms of spinning charged %d ms of user time", cycles_to_ms(d));
+	}
+
+	// Mostly syscalls.
+	k = env->env_ktime;
+	for (int i = 0; i < 2000; i++) {
+		syscall_getenvid();
+	}
+	if (env->env_ktime == k) {
+		user_panic("syscalls charged no kernel time");
+	}
+
+	// Sleeping costs neither.
+	u = env->env_utime;
+	k = env->env_ktime;
+	syscall_sleep(50 * MS);
+	d = (env->env_utime - u) + (env->env_ktime - k);
+	if (d > 10 * MS) {
+		user_panic("sleeping 50 ms charged %d ms", cycles_to_ms(d));
+	}
+
+	// The child's 20 ms reach us when it's freed.
+	u = env->env_cutime;
+	if ((child = fork()) == 0) {
+		t = now();
+		while (now() - t < 20 * MS) {
+		}
+		exit(0);
+	}
+	ipc_recv(&who, 0, 0);
+	while (envs[ENVX(child)].env_id == child && envs[ENVX(child)].env_status != ENV_FREE) {
+		syscall_yield();
+	}
+	if (env->env_cutime - u < 10 * MS) {
+		user_panic("the child's time was not added: %d ms", cycles_to_ms(env->env_cutime - u));
+	}
+
+	debugf("cputime_check() succeeded!\n");
+	return 0;
+}
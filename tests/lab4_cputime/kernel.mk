@@ -0,0 +1 @@
+init-envs := cputime_check
@@ -0,0 +1,81 @@
+// Fork benchmark: the time 'fork' (page tables copied by the kernel) and 'ufork' (copied page by
+// page from user space) take to create a child, for growing amounts of resident memory.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define BENCH_VA 0x20000000
+#define NROUNDS 8
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static u_int us(uint64_t cycles) {
+	return (u_int)(cycles >> 2) / (MS / 4000);
+}
+
+// Return the average time 'f' takes to create a child, which exits at once.
+static u_int bench(int (*f)(void)) {
+	uint64_t sum = 0, t;
+	u_int who;
+	int child;
+
+	for (int i = 0; i < NROUNDS; i++) {
+		t = now();
+		if ((child = f()) == 0) {
+			exit(0);
+		}
+		sum += now() - t;
+		if (child < 0) {
+			user_panic("fork: %d", child);
+		}
+		ipc_recv(&who, 0, 0); // the exit status of the child
+	}
+	return us(sum) / NROUNDS;
+}
+
+int main() {
+	static const u_int sizes[] = {0, 64, 256, 1024};
+	u_int mapped = 0;
+
+	for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		if (sizes[i] > mapped) {
+			panic_on(syscall_mem_alloc_range(0, (void *)(BENCH_VA + mapped * PAGE_SIZE),
+							 sizes[i] - mapped, PTE_D));
+		}
+		for (; mapped < sizes[i]; mapped++) {
+			*(volatile u_int *)(BENCH_VA + mapped * PAGE_SIZE) = mapped;
+		}
+		debugf("fork_bench: %d extra pages: fork %d us, ufork %d us\n", sizes[i], bench(fork),
+		       bench(ufork));
+	}
+
+	// Both kinds of children see our memory and share it copy-on-write.
+	for (int k = 0; k < 2; k++) {
+		int child = (k == 0 ? fork : ufork)();
+		u_int who;
+
+		if (child == 0) {
+			for (u_int i = 0; i < mapped; i++) {
+				if (*(volatile u_int *)(BENCH_VA + i * PAGE_SIZE) != i) {
+					user_panic("child: bad page %d", i);
+				}
+				*(volatile u_int *)(BENCH_VA + i * PAGE_SIZE) = ~i;
+			}
+			exit(0);
+		}
+		ipc_recv(&who, 0, 0);
+		for (u_int i = 0; i < mapped; i++) {
+			if (*(volatile u_int *)(BENCH_VA + i * PAGE_SIZE) != i) {
+				user_panic("parent: page %d changed by the child", i);
+			}
+		}
+	}
+
+	debugf("fork_bench done\n");
+	return 0;
+}
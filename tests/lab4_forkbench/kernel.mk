@@ -0,0 +1 @@
+init-envs := fork_bench
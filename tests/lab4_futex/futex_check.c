@@ -0,0 +1,137 @@
+// Futex check: waiters block off the run queues and are woken by the physical word, and the
+// mutex, condition variable and semaphore of the user library work between envs sharing a page.
+
+#include <lib.h>
+
+#define SHARED_VA 0x20000000
+#define ALIAS_VA 0x20400000
+#define NCHILD 4
+#define NLOOP 200
+#define NITEMS 100
+
+struct Shared {
+	u_int word;
+	struct Mutex lock;
+	u_int counter;
+	struct Cond nonempty, nonfull;
+	u_int items[4];
+	u_int head, tail;
+	struct Sem sem;
+};
+
+static struct Shared *sh = (struct Shared *)SHARED_VA;
+
+static void recv_exits(int n) {
+	u_int who;
+
+	while (n-- > 0) {
+		ipc_recv(&who, 0, 0);
+	}
+}
+
+static void expect_blocked(u_int envid) {
+	for (int i = 0; i < 10; i++) {
+		syscall_yield();
+	}
+	if (envs[ENVX(envid)].env_status != ENV_NOT_RUNNABLE) {
+		user_panic("env %x is not blocked", envid);
+	}
+}
+
+int main() {
+	int child, i, sum;
+
+	panic_on(syscall_mem_alloc(0, (void *)SHARED_VA, PTE_D | PTE_LIBRARY));
+
+	// Waiting on a word which doesn't hold the expected value returns at once.
+	if (syscall_futex_wait(&sh->word, 1) != -E_AGAIN) {
+		user_panic("futex_wait didn't check the value");
+	}
+	if (syscall_futex_wake(&sh->word, 1) != 0) {
+		user_panic("futex_wake woke someone up without waiters");
+	}
+
+	// A waiter is woken through another mapping of the same page.
+	panic_on(syscall_mem_map(0, (void *)SHARED_VA, 0, (void *)ALIAS_VA, PTE_D | PTE_LIBRARY));
+	if ((child = fork()) == 0) {
+		panic_on(syscall_futex_wait(&sh->word, 0));
+		exit(sh->word);
+	}
+	expect_blocked(child);
+	((struct Shared *)ALIAS_VA)->word = 7;
+	if (syscall_futex_wake(&((struct Shared *)ALIAS_VA)->word, 1) != 1) {
+		user_panic("futex_wake didn't find the waiter through an alias");
+	}
+	recv_exits(1);
+
+	// Mutex: the counter is only updated under the lock, with yields in the critical section.
+	for (i = 0; i < NCHILD; i++) {
+		if (fork() == 0) {
+			for (int j = 0; j < NLOOP; j++) {
+				mutex_lock(&sh->lock);
+				u_int c = sh->counter;
+				if (j % 8 == 0) {
+					syscall_yield();
+				}
+				sh->counter = c + 1;
+				mutex_unlock(&sh->lock);
+			}
+			exit(0);
+		}
+	}
+	recv_exits(NCHILD);
+	if (sh->counter != NCHILD * NLOOP) {
+		user_panic("counter is %d, not %d", sh->counter, NCHILD * NLOOP);
+	}
+
+	// Condition variables: a bounded buffer between a producer and us.
+	if (fork() == 0) {
+		for (u_int v = 1; v <= NITEMS; v++) {
+			mutex_lock(&sh->lock);
+			while (sh->tail - sh->head == 4) {
+				cond_wait(&sh->nonfull, &sh->lock);
+			}
+			sh->items[sh->tail++ % 4] = v;
+			cond_signal(&sh->nonempty);
+			mutex_unlock(&sh->lock);
+		}
+		exit(0);
+	}
+	for (i = 0, sum = 0; i < NITEMS; i++) {
+		mutex_lock(&sh->lock);
+		while (sh->tail == sh->head) {
+			cond_wait(&sh->nonempty, &sh->lock);
+		}
+		sum += sh->items[sh->head++ % 4];
+		cond_signal(&sh->nonfull);
+		mutex_unlock(&sh->lock);
+	}
+	recv_exits(1);
+	if (sum != NITEMS * (NITEMS + 1) / 2) {
+		user_panic("bounded buffer sum is %d", sum);
+	}
+
+	// Semaphore: the children block until we post.
+	sem_init(&sh->sem, 0);
+	u_int children[NCHILD];
+	for (i = 0; i < NCHILD; i++) {
+		if ((child = fork()) == 0) {
+			sem_wait(&sh->sem);
+			exit(0);
+		}
+		children[i] = child;
+	}
+	for (i = 0; i < NCHILD; i++) {
+		expect_blocked(children[i]);
+	}
+	for (i = 0; i < NCHILD; i++) {
+		sem_post(&sh->sem);
+	}
+	recv_exits(NCHILD);
+	if (sh->sem.s_value != 0) {
+		user_panic("semaphore value is %d", sh->sem.s_value);
+	}
+
+	debugf("futex_check() succeeded!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := futex_check
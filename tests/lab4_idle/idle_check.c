@@ -0,0 +1,57 @@
+// Idle check: with nothing else runnable, a sleeping env leaves the CPU idle in the wait loop,
+// and CP0_Compare is programmed to its deadline, so it wakes up on time rather than at the
+// next tick, and the idle CPU takes no clock interrupts in between.
+
+#include <lib.h>
+
+#define US (KCLOCK_HZ / 1000000)
+#define MS (KCLOCK_HZ / 1000)
+
+// Not multiples of a tick, so that a tick-driven wake-up would be late by half a tick on average.
+static const u_int lengths[] = {100, 1300, 2700, 4900, 7300, 12100}; // in us
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+int main() {
+	uint64_t t0, t1, late = 0;
+	u_int n = 0, ticks;
+
+	for (int i = 0; i < NENV; i++) {
+		if (envs[i].env_status == ENV_RUNNABLE && envs[i].env_id != env->env_id) {
+			user_panic("%x is runnable besides us", envs[i].env_id);
+		}
+	}
+
+	for (int round = 0; round < 4; round++) {
+		for (int i = 0; i < sizeof lengths / sizeof lengths[0]; i++, n++) {
+			t0 = now();
+			panic_on(syscall_sleep(lengths[i] * US));
+			t1 = now();
+			if (t1 - t0 < lengths[i] * US) {
+				user_panic("a %d us sleep woke up after %d us", lengths[i],
+					   (u_int)(t1 - t0) / US);
+			}
+			late += t1 - t0 - lengths[i] * US;
+		}
+	}
+	debugf("sleeps woke up %d us late on average\n", (u_int)(late / n) / US);
+	if (late / n > TIMER_INTERVAL / 4) {
+		user_panic("sleeps woke up %d us late on average, tick-driven", (u_int)(late / n) / US);
+	}
+
+	// A long sleep is a single wake-up: 'uk_ticks' counts the clock interrupts of the idle CPU.
+	ticks = ukdata->uk_ticks;
+	panic_on(syscall_sleep(50 * MS));
+	ticks = ukdata->uk_ticks - ticks;
+	if (ticks > 2) {
+		user_panic("a 50 ms sleep took %d clock interrupts", ticks);
+	}
+
+	debugf("idle_check() succeeded!\n");
+	return 0;
+}
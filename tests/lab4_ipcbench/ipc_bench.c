@@ -0,0 +1,88 @@
+// Null-RPC benchmark: a round trip to a server which replies the value it got plus one, with
+// 'ipc_send' and 'ipc_recv' on both sides against 'ipc_call' and 'ipc_reply_and_recv'.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define NCALLS 1000
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static u_int us(uint64_t cycles) {
+	return (u_int)(cycles >> 2) / (MS / 4000);
+}
+
+static int server(int combined) {
+	u_int who = 0, val = 0;
+	int child = fork();
+
+	if (child < 0) {
+		user_panic("fork: %d", child);
+	}
+	if (child != 0) {
+		return child;
+	}
+	for (;;) {
+		if (combined) {
+			val = ipc_reply_and_recv(who, val + 1, 0, 0, &who, 0, 0);
+		} else {
+			val = ipc_recv(&who, 0, 0);
+			ipc_send(who, val + 1, 0, 0);
+		}
+	}
+}
+
+static u_int bench(int combined) {
+	int srv = server(combined);
+	uint64_t t0;
+	u_int who, val;
+
+	t0 = now();
+	for (u_int i = 0; i < NCALLS; i++) {
+		if (combined) {
+			val = ipc_call(srv, i, 0, 0, 0, 0);
+		} else {
+			ipc_send(srv, i, 0, 0);
+			val = ipc_recv(&who, 0, 0);
+		}
+		if (val != i + 1) {
+			user_panic("reply %d to %d", val, i);
+		}
+	}
+	t0 = now() - t0;
+	panic_on(syscall_env_destroy(srv));
+	return (u_int)t0 / NCALLS;
+}
+
+int main() {
+	u_int split, combined;
+	struct Sysstat a, b;
+	int srv;
+
+	split = bench(0);
+	combined = bench(1);
+	debugf("null RPC: %d cycles (%d us) with ipc_send/ipc_recv, %d cycles (%d us) with "
+	       "ipc_call\n",
+	       split, us(split), combined, us(combined));
+
+	// A call is a single syscall.
+	srv = server(1);
+	syscall_sysstat(0, &a);
+	if (ipc_call(srv, 41, 0, 0, 0, 0) != 42) {
+		user_panic("bad reply");
+	}
+	if (syscall_sysstat(0, &b) == 0 &&
+	    b.ss_env[SYS_ipc_call].sc_count - a.ss_env[SYS_ipc_call].sc_count != 1) {
+		user_panic("ipc_call took %d syscalls",
+			   b.ss_env[SYS_ipc_call].sc_count - a.ss_env[SYS_ipc_call].sc_count);
+	}
+	panic_on(syscall_env_destroy(srv));
+
+	debugf("ipc_bench done\n");
+	return 0;
+}
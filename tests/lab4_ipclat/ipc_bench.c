@@ -0,0 +1,71 @@
+// Null-RPC latency benchmark: the average round trip of an empty request and reply between two
+// envs, as the number of CPU hogs running alongside them grows. The CPU is handed over with each
+// message, so the round trip should not wait behind the hogs.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define MAX_HOGS 8
+#define ROUNDS 200
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static void server(void) {
+	u_int who, v;
+
+	for (;;) {
+		v = ipc_recv(&who, 0, 0);
+		ipc_send(who, v + 1, 0, 0);
+	}
+}
+
+static int start(void (*fn)(void)) {
+	int child = fork();
+
+	if (child < 0) {
+		user_panic("fork: %d", child);
+	}
+	if (child == 0) {
+		fn();
+	}
+	return child;
+}
+
+static void hog(void) {
+	for (;;) {
+	}
+}
+
+int main() {
+	int srv = start(server), hogs[MAX_HOGS];
+	u_int who, nhogs = 0;
+	uint64_t t;
+
+	for (u_int n = 0; n <= MAX_HOGS; n = n == 0 ? 1 : n * 2) {
+		while (nhogs < n) {
+			hogs[nhogs++] = start(hog);
+		}
+		t = now();
+		for (u_int i = 0; i < ROUNDS; i++) {
+			ipc_send(srv, i, 0, 0);
+			if (ipc_recv(&who, 0, 0) != i + 1 || who != srv) {
+				user_panic("bad reply from %x", who);
+			}
+		}
+		t = now() - t;
+		debugf("%d hogs: %d us per null RPC\n", n,
+		       (u_int)(t >> 2) / (MS / 4000) / ROUNDS);
+	}
+
+	for (u_int i = 0; i < nhogs; i++) {
+		panic_on(syscall_env_destroy(hogs[i]));
+	}
+	panic_on(syscall_env_destroy(srv));
+	debugf("ipc_bench done\n");
+	return 0;
+}
@@ -0,0 +1,84 @@
+// Blocking IPC send check: senders to an env which is not receiving wait in the kernel, not
+// runnable, and their messages are taken in the order they started waiting; senders to an env
+// which is destroyed are woken up with -E_BAD_ENV.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define NSENDERS 4
+#define NMSGS 20
+
+static void expect_blocked(u_int envid) {
+	if (envs[ENVX(envid)].env_status != ENV_NOT_RUNNABLE) {
+		user_panic("sender %x is not blocked", envid);
+	}
+}
+
+static int child(void) {
+	int r = fork();
+
+	if (r < 0) {
+		user_panic("fork: %d", r);
+	}
+	return r;
+}
+
+int main() {
+	u_int senders[NSENDERS], next[NSENDERS], seen = 0, who, val, i, j;
+	int victim, r;
+
+	// Each sender sends 1 to 'NMSGS', then its exit status 0.
+	for (i = 0; i < NSENDERS; i++) {
+		if ((senders[i] = child()) == 0) {
+			for (j = 1; j <= NMSGS; j++) {
+				ipc_send(env->env_parent_id, j, 0, 0);
+			}
+			return 0;
+		}
+		next[i] = 1;
+	}
+	panic_on(syscall_sleep(20 * MS));
+	for (i = 0; i < NSENDERS; i++) {
+		expect_blocked(senders[i]);
+	}
+
+	for (j = 0; j < NSENDERS * (NMSGS + 1); j++) {
+		val = ipc_recv(&who, 0, 0);
+		for (i = 0; i < NSENDERS && senders[i] != who; i++) {
+		}
+		if (i == NSENDERS) {
+			user_panic("message from unknown env %x", who);
+		}
+		// All were waiting, so each sender comes once before any comes again.
+		if (j < NSENDERS && (seen & (1 << i))) {
+			user_panic("sender %x came twice in the first round", who);
+		}
+		seen |= 1 << i;
+		if (val != (next[i] == NMSGS + 1 ? 0 : next[i])) {
+			user_panic("sender %x: got %d, expected message %d", who, val, next[i]);
+		}
+		next[i]++;
+	}
+
+	// A sender blocked on an env which is destroyed gets -E_BAD_ENV.
+	if ((victim = child()) == 0) {
+		for (;;) {
+			syscall_sleep(1000 * MS);
+		}
+	}
+	if ((senders[0] = child()) == 0) {
+		r = syscall_ipc_send(victim, 1, 0, 0);
+		ipc_send(env->env_parent_id, (u_int)r, 0, 0);
+		return 0;
+	}
+	panic_on(syscall_sleep(20 * MS));
+	expect_blocked(senders[0]);
+	panic_on(syscall_env_destroy(victim));
+	if ((r = ipc_recv(&who, 0, 0)) != -E_BAD_ENV || who != senders[0]) {
+		user_panic("send to a destroyed env returned %d", r);
+	}
+	ipc_recv(&who, 0, 0); // the exit status of the sender
+
+	debugf("ipc_queue() succeeded!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := ksm_check
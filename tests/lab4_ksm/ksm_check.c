@@ -0,0 +1,89 @@
+// KSM check: pages with equal content get merged into one copy-on-write page, and writes (from
+// user space, or by the kernel on behalf of a syscall) split them again. This env never forks, so
+// it has no user TLB Mod handler and relies on the kernel copying the pages.
+
+#include <lib.h>
+
+#define CHECK_VA 0x20000000
+#define SAME_PAGES 64
+#define OTHER_PAGES 16
+#define MAX_YIELDS 100000
+
+static u_int *page(int i) {
+	return (u_int *)(CHECK_VA + i * PAGE_SIZE);
+}
+
+static u_int pa(int i) {
+	return PTE_ADDR(vpt[VPN(page(i))]);
+}
+
+static void wait_passes(u_int n, struct Ksm_info *ks) {
+	u_int start;
+
+	syscall_ksm_ctl(-1, ks);
+	start = ks->ks_runs;
+	for (int i = 0; ks->ks_runs < start + n; i++) {
+		if (i == MAX_YIELDS) {
+			user_panic("the KSM scanner made no progress");
+		}
+		syscall_yield();
+		syscall_ksm_ctl(-1, ks);
+	}
+}
+
+int main() {
+	struct Ksm_info ks;
+	int i, j;
+
+	if (syscall_ksm_ctl(KSM_MAX_RATE, &ks) < 0 || ks.ks_rate != KSM_MAX_RATE) {
+		user_panic("cannot set the KSM rate");
+	}
+
+	for (i = 0; i < SAME_PAGES + OTHER_PAGES; i++) {
+		for (j = 0; j < PAGE_SIZE / 4; j++) {
+			page(i)[j] = i < SAME_PAGES ? 0x5a5a0000 | j : (i << 16) | j;
+		}
+	}
+
+	// The first pass only takes the checksums, the second one merges.
+	wait_passes(3, &ks);
+	debugf("ksm: %d shared pages, %d pages saved\n", ks.ks_shared, ks.ks_sharing);
+	if (ks.ks_sharing < SAME_PAGES - 1) {
+		user_panic("only %d pages saved", ks.ks_sharing);
+	}
+	for (i = 0; i < SAME_PAGES; i++) {
+		if (pa(i) != pa(0) || !(vpt[VPN(page(i))] & PTE_COW) || (vpt[VPN(page(i))] & PTE_D)) {
+			user_panic("page %d not merged", i);
+		}
+	}
+	for (i = SAME_PAGES; i < SAME_PAGES + OTHER_PAGES; i++) {
+		if (pa(i) == pa(0) || (i > SAME_PAGES && pa(i) == pa(i - 1))) {
+			user_panic("page %d merged with different content", i);
+		}
+	}
+
+	// A write gets a private copy, the other pages keep their content.
+	page(5)[7] = 0xdeadbeef;
+	if (pa(5) == pa(0) || !(vpt[VPN(page(5))] & PTE_D)) {
+		user_panic("page 5 not copied on write");
+	}
+	// So does a write by the kernel.
+	syscall_ksm_ctl(-1, (struct Ksm_info *)page(6));
+	if (pa(6) == pa(0) || page(6)[0] != KSM_MAX_RATE) {
+		user_panic("page 6 not copied on a kernel write");
+	}
+	for (i = 0; i < SAME_PAGES; i++) {
+		for (j = 0; j < PAGE_SIZE / 4; j++) {
+			if (i == 5 && j == 7) {
+				if (page(i)[j] != 0xdeadbeef) {
+					user_panic("write to page 5 lost");
+				}
+			} else if (i != 6 && page(i)[j] != (0x5a5a0000 | j)) {
+				user_panic("page %d corrupted at word %d: %x", i, j, page(i)[j]);
+			}
+		}
+	}
+
+	debugf("ksm_check() succeeded!\n");
+	return 0;
+}
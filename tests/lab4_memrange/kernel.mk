@@ -0,0 +1 @@
+init-envs := memrange_check
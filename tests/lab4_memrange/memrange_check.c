@@ -0,0 +1,62 @@
+// Range mapping check: 'syscall_mem_alloc_range', 'syscall_mem_map_range' and
+// 'syscall_mem_unmap_range' map and unmap whole ranges, and no stale TLB entry survives them,
+// for small ranges (invalidated page by page) and large ones (whole ASID flushed).
+
+#include <lib.h>
+
+#define SRC_VA 0x20000000
+#define DST_VA 0x30000000
+
+static volatile u_int *word(u_int base, u_int i) {
+	return (volatile u_int *)(base + i * PAGE_SIZE);
+}
+
+static void check(u_int npages) {
+	u_int i;
+
+	panic_on(syscall_mem_alloc_range(0, (void *)SRC_VA, npages, PTE_D));
+	for (i = 0; i < npages; i++) {
+		*word(SRC_VA, i) = i + 1;
+	}
+
+	// Load the TLB with the old mappings of the destination, then replace them.
+	panic_on(syscall_mem_alloc_range(0, (void *)DST_VA, npages, PTE_D));
+	for (i = 0; i < npages; i++) {
+		*word(DST_VA, i) = 0xdead;
+	}
+	panic_on(syscall_mem_map_range(0, (void *)SRC_VA, 0, (void *)DST_VA, npages, PTE_D));
+	for (i = 0; i < npages; i++) {
+		if (*word(DST_VA, i) != i + 1) {
+			user_panic("%d pages: page %d not remapped: %x", npages, i, *word(DST_VA, i));
+		}
+	}
+	*word(DST_VA, 0) = 0xbeef;
+	if (*word(SRC_VA, 0) != 0xbeef) {
+		user_panic("%d pages: the range is not shared", npages);
+	}
+
+	// Unmapped pages read as zero again, not through a stale entry.
+	panic_on(syscall_mem_unmap_range(0, (void *)SRC_VA, npages));
+	panic_on(syscall_mem_unmap_range(0, (void *)DST_VA, npages));
+	for (i = 0; i < npages; i++) {
+		if (*word(SRC_VA, i) != 0 || *word(DST_VA, i) != 0) {
+			user_panic("%d pages: page %d still mapped after unmap", npages, i);
+		}
+	}
+	panic_on(syscall_mem_unmap_range(0, (void *)SRC_VA, npages));
+	panic_on(syscall_mem_unmap_range(0, (void *)DST_VA, npages));
+}
+
+int main() {
+	check(1);
+	check(5);
+	check(4 * TLB_FLUSH_PAIRS);
+
+	if (syscall_mem_alloc_range(0, (void *)(UTOP - PAGE_SIZE), 2, PTE_D) != -E_INVAL ||
+	    syscall_mem_unmap_range(0, (void *)SRC_VA, ~0u) != -E_INVAL) {
+		user_panic("illegal ranges are accepted");
+	}
+
+	debugf("memrange_check() succeeded!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := mem_check
@@ -0,0 +1,86 @@
+// Memory accounting check: the per-env counters reported by 'syscall_mem_stat' follow mappings
+// made by syscalls, demand faults, and fork.
+
+#include <lib.h>
+
+#define CHECK_VA 0x20000000
+#define NPAGES 8
+
+static struct Env_mem mem_of(u_int envid) {
+	struct Mem_stat ms;
+
+	if (syscall_mem_stat(envid, &ms) < 0) {
+		user_panic("cannot get the memory statistics of %x", envid);
+	}
+	if (ms.ms_free == 0 || ms.ms_free >= ms.ms_total) {
+		user_panic("bad free page count %d of %d", ms.ms_free, ms.ms_total);
+	}
+	return ms.ms_env;
+}
+
+static void expect(const char *what, struct Env_mem *a, struct Env_mem *b, int resident,
+		   int ptpages, int shared, int cow) {
+	if (b->em_resident - a->em_resident != resident || b->em_ptpages - a->em_ptpages != ptpages ||
+	    b->em_shared - a->em_shared != shared || b->em_cow - a->em_cow != cow) {
+		user_panic("%s: resident %d ptpages %d shared %d cow %d", what,
+			   b->em_resident - a->em_resident, b->em_ptpages - a->em_ptpages,
+			   b->em_shared - a->em_shared, b->em_cow - a->em_cow);
+	}
+}
+
+int main() {
+	struct Env_mem a, b, c;
+	u_int i, who;
+	int child;
+
+	// Keep the KSM scanner from merging the pages under test.
+	syscall_ksm_ctl(0, 0);
+
+	a = mem_of(0);
+	for (i = 0; i < NPAGES; i++) {
+		if (syscall_mem_alloc(0, (void *)(CHECK_VA + i * PAGE_SIZE), PTE_D) < 0) {
+			user_panic("mem_alloc failed");
+		}
+	}
+	b = mem_of(0);
+	expect("mem_alloc", &a, &b, NPAGES, 1, 0, 0);
+
+	// Mapping a page twice makes both mappings shared.
+	syscall_mem_map(0, (void *)CHECK_VA, 0, (void *)(CHECK_VA + NPAGES * PAGE_SIZE), PTE_D);
+	c = mem_of(0);
+	expect("mem_map", &b, &c, 1, 0, 2, 0);
+	syscall_mem_unmap(0, (void *)(CHECK_VA + NPAGES * PAGE_SIZE));
+	c = mem_of(0);
+	expect("mem_unmap", &b, &c, 0, 0, 0, 0);
+
+	// A read fault maps the shared zero page copy-on-write.
+	i = *(volatile u_int *)(CHECK_VA + (NPAGES + 1) * PAGE_SIZE);
+	c = mem_of(0);
+	expect("zero page", &b, &c, 1, 0, 1, 1);
+
+	// After fork, the pages are shared copy-on-write with the child.
+	if ((child = fork()) == 0) {
+		c = mem_of(0);
+		if (c.em_cow < NPAGES || c.em_shared < NPAGES) {
+			user_panic("child: cow %d shared %d", c.em_cow, c.em_shared);
+		}
+		// Stay alive until the parent has looked at us.
+		ipc_send(env->env_parent_id, c.em_resident, 0, 0);
+		ipc_recv(&who, 0, 0);
+		return 0;
+	}
+	i = ipc_recv(&who, 0, 0);
+	c = mem_of(0);
+	if (c.em_cow < b.em_cow + NPAGES || c.em_shared < b.em_shared + NPAGES) {
+		user_panic("parent: cow %d shared %d", c.em_cow, c.em_shared);
+	}
+	if (mem_of(child).em_resident != i) {
+		user_panic("the child's statistics differ when asked from its parent");
+	}
+	ipc_send(child, 0, 0, 0);
+	ipc_recv(&who, 0, 0); // the exit status of the child
+
+	syscall_ksm_ctl(KSM_DEFAULT_RATE, 0);
+	debugf("mem_check() succeeded!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := multicall_check
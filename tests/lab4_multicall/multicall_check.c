@@ -0,0 +1,89 @@
+// Batched syscall check: 'syscall_multicall' runs its entries in order, reports the result of
+// each, and stops at the first one which fails.
+
+#include <lib.h>
+
+#define CHECK_VA 0x20000000
+
+static int mapped(u_int va) {
+	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & PTE_V);
+}
+
+int main() {
+	struct Multicall_batch b;
+	u_int va = CHECK_VA;
+	int r, child;
+
+	multicall_init(&b);
+	panic_on(multicall_add(&b, SYS_getenvid, 0, 0, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_mem_alloc, 0, va, PTE_D, 0, 0));
+	panic_on(multicall_add(&b, SYS_mem_map, 0, va, 0, va + PAGE_SIZE, PTE_D));
+	panic_on(multicall_flush(&b));
+	if (b.mb_done != 3 || b.mb_calls[0].mc_result != syscall_getenvid()) {
+		user_panic("bad results: %d done, envid %x", b.mb_done, b.mb_calls[0].mc_result);
+	}
+	*(volatile u_int *)va = 0x1234;
+	if (*(volatile u_int *)(va + PAGE_SIZE) != 0x1234) {
+		user_panic("the batched mem_map did not share the page");
+	}
+
+	// Stop at the unmapped source page: the last entry is not run.
+	panic_on(multicall_add(&b, SYS_mem_unmap, 0, va + PAGE_SIZE, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_mem_map, 0, va + 2 * PAGE_SIZE, 0, va + 3 * PAGE_SIZE, PTE_D));
+	panic_on(multicall_add(&b, SYS_mem_alloc, 0, va + 4 * PAGE_SIZE, PTE_D, 0, 0));
+	r = multicall_flush(&b);
+	if (r != -E_INVAL || b.mb_done != 1 || b.mb_calls[1].mc_result != -E_INVAL) {
+		user_panic("stop on error: r %d, %d done", r, b.mb_done);
+	}
+	if (mapped(va + PAGE_SIZE) || mapped(va + 4 * PAGE_SIZE)) {
+		user_panic("wrong mappings after the failed batch");
+	}
+
+	// Syscalls which don't return may not be batched.
+	panic_on(multicall_add(&b, SYS_yield, 0, 0, 0, 0, 0));
+	if (multicall_flush(&b) != -E_INVAL || b.mb_done != 0) {
+		user_panic("yield was batched");
+	}
+
+	// Nor may those which switch envs when applied to us, but they may be for other envs.
+	panic_on(multicall_add(&b, SYS_getenvid, 0, 0, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_set_env_status, 0, ENV_RUNNABLE, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_mem_alloc, 0, va + 4 * PAGE_SIZE, PTE_D, 0, 0));
+	if (multicall_flush(&b) != -E_INVAL || b.mb_done != 1 || mapped(va + 4 * PAGE_SIZE)) {
+		user_panic("set_env_status of ourselves was batched");
+	}
+	panic_on(multicall_add(&b, SYS_env_destroy, 0, 0, 0, 0, 0));
+	if (multicall_flush(&b) != -E_INVAL || b.mb_done != 0) {
+		user_panic("env_destroy of ourselves was batched");
+	}
+	panic_on(multicall_add(&b, SYS_cgetc, 0, 0, 0, 0, 0));
+	if (multicall_flush(&b) != -E_INVAL || b.mb_done != 0) {
+		user_panic("cgetc was batched");
+	}
+	if ((child = fork()) == 0) {
+		for (;;) {
+			syscall_yield();
+		}
+	}
+	panic_on(multicall_add(&b, SYS_set_env_status, child, ENV_NOT_RUNNABLE, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_env_destroy, child, 0, 0, 0, 0));
+	panic_on(multicall_add(&b, SYS_getenvid, 0, 0, 0, 0, 0));
+	if (multicall_flush(&b) != 0 || b.mb_done != 3 ||
+	    envs[ENVX(child)].env_status != ENV_FREE) {
+		user_panic("the batch on a child did not complete: %d done", b.mb_done);
+	}
+
+	// A batch larger than 'MULTICALL_MAX' is run in parts.
+	for (u_int i = 0; i < 3 * MULTICALL_MAX; i++) {
+		panic_on(multicall_add(&b, SYS_mem_alloc, 0, va + (8 + i) * PAGE_SIZE, PTE_D, 0, 0));
+	}
+	panic_on(multicall_flush(&b));
+	for (u_int i = 0; i < 3 * MULTICALL_MAX; i++) {
+		if (!mapped(va + (8 + i) * PAGE_SIZE)) {
+			user_panic("page %d of the large batch is not mapped", i);
+		}
+	}
+
+	debugf("multicall_check() succeeded!\n");
+	return 0;
+}
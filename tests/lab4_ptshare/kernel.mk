@@ -0,0 +1 @@
+init-envs := pt_check
@@ -0,0 +1,96 @@
+// Page table sharing check: after 'fork', the child uses the page tables of its parent until
+// either of them writes through one, and their memory stays copy-on-write all along.
+
+#include <lib.h>
+
+#define DATA_VA 0x20000000
+#define SHM_VA 0x30000000
+#define NPAGES 64
+
+// Shared with the children: the page directory entries of the parent, then a flag.
+static volatile u_int *shm = (volatile u_int *)SHM_VA;
+
+static void fill(u_int v) {
+	for (u_int i = 0; i < NPAGES; i++) {
+		*(volatile u_int *)(DATA_VA + i * PAGE_SIZE) = v + i;
+	}
+}
+
+static void expect(u_int v, const char *who) {
+	for (u_int i = 0; i < NPAGES; i++) {
+		if (*(volatile u_int *)(DATA_VA + i * PAGE_SIZE) != v + i) {
+			user_panic("%s: page %d holds %x instead of %x", who, i,
+				   *(volatile u_int *)(DATA_VA + i * PAGE_SIZE), v + i);
+		}
+	}
+}
+
+static u_int table(u_int va) {
+	return PTE_ADDR(vpd[PDX(va)]);
+}
+
+int main() {
+	u_int who, pt;
+	int child;
+
+	panic_on(syscall_mem_alloc_range(0, (void *)DATA_VA, NPAGES, PTE_D));
+	panic_on(syscall_mem_alloc(0, (void *)SHM_VA, PTE_D | PTE_LIBRARY));
+	fill(100);
+
+	// The child writes first and gets its own copy of the table.
+	shm[0] = table(DATA_VA);
+	shm[1] = table(SHM_VA);
+	if (fork() == 0) {
+		if (table(DATA_VA) != shm[0]) {
+			user_panic("child: the page table is not shared");
+		}
+		if (table(SHM_VA) == shm[1]) {
+			user_panic("child: a page table mapping shared memory is shared");
+		}
+		expect(100, "child");
+		fill(200);
+		if (table(DATA_VA) == shm[0]) {
+			user_panic("child: the page table is still shared after a write");
+		}
+		shm[2] = 1;
+		return 0;
+	}
+	ipc_recv(&who, 0, 0); // the exit status of the child
+	if (shm[2] != 1) {
+		user_panic("the child's writes to shared memory are lost");
+	}
+	expect(100, "parent");
+
+	// The parent writes first: the child keeps the table.
+	pt = table(DATA_VA);
+	if ((child = fork()) == 0) {
+		ipc_recv(&who, 0, 0);
+		if (table(DATA_VA) != pt) {
+			user_panic("child: the page table moved");
+		}
+		expect(100, "child");
+		return 0;
+	}
+	fill(300);
+	if (table(DATA_VA) == pt) {
+		user_panic("parent: the page table is still shared after a write");
+	}
+	ipc_send(child, 0, 0, 0);
+	ipc_recv(&who, 0, 0);
+	expect(300, "parent");
+
+	// Once the child is gone, the table is private again and needs no copy.
+	pt = table(DATA_VA);
+	if (fork() == 0) {
+		return 0;
+	}
+	ipc_recv(&who, 0, 0);
+	fill(400);
+	if (table(DATA_VA) != pt) {
+		user_panic("parent: the page table was copied after the child exited");
+	}
+	expect(400, "parent");
+
+	debugf("pt_check() succeeded!\n");
+	return 0;
+}
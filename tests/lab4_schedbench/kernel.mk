@@ -0,0 +1 @@
+init-envs := sched_bench
@@ -0,0 +1,102 @@
+// Scheduler benchmark, to be run with both policies ('make test lab=4_schedbench', then again
+// with 'MOS_SCHED=cfs' after 'make clean'):
+//   - interactive latency: how late an env sleeping 2 ms at a time wakes up while CPU hogs run;
+//   - throughput: the work done by the hogs meanwhile;
+//   - fork fairness: the share of the CPU a hog gets against 4 hogs forked by another env.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define COUNTERS_VA 0x20000000
+#define NHOGS 3
+#define NFORKED 4
+#define NSLEEPS 100
+#define FAIR_MS 500
+
+#ifdef MOS_SCHED_CFS
+#define POLICY "cfs"
+#else
+#define POLICY "levels"
+#endif
+
+// Shared with all the hogs.
+static volatile u_int *counters = (volatile u_int *)COUNTERS_VA;
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static int hog(u_int slot) {
+	int child = fork();
+
+	if (child == 0) {
+		for (;;) {
+			counters[slot]++;
+		}
+	}
+	if (child < 0) {
+		user_panic("fork: %d", child);
+	}
+	return child;
+}
+
+static u_int us(uint64_t cycles) {
+	return (u_int)(cycles >> 2) / (MS / 4000);
+}
+
+int main() {
+	uint64_t t0, target, late, sum = 0, max = 0;
+	int hogs[NHOGS], forked[NFORKED], forker, single;
+	u_int work, who;
+
+	panic_on(syscall_mem_alloc(0, (void *)COUNTERS_VA, PTE_D | PTE_LIBRARY));
+
+	for (int i = 0; i < NHOGS; i++) {
+		hogs[i] = hog(0);
+	}
+	t0 = now();
+	for (int i = 0; i < NSLEEPS; i++) {
+		target = now() + 2 * MS;
+		panic_on(syscall_sleep(2 * MS));
+		late = now() - target;
+		sum += late;
+		if (late > max) {
+			max = late;
+		}
+	}
+	work = counters[0];
+	t0 = now() - t0;
+	for (int i = 0; i < NHOGS; i++) {
+		panic_on(syscall_env_destroy(hogs[i]));
+	}
+	debugf("%s: wake-up latency with %d hogs: avg %d us, max %d us\n", POLICY, NHOGS,
+	       us(sum) / NSLEEPS, us(max));
+	debugf("%s: throughput: %d iterations in %d ms\n", POLICY, work, us(t0) / 1000);
+
+	// One env forks 'NFORKED' hogs, which compete with a single one.
+	counters[1] = counters[2] = 0;
+	if ((forker = fork()) == 0) {
+		for (int i = 0; i < NFORKED; i++) {
+			forked[i] = hog(1);
+		}
+		ipc_recv(&who, 0, 0);
+		for (int i = 0; i < NFORKED; i++) {
+			panic_on(syscall_env_destroy(forked[i]));
+		}
+		return 0;
+	}
+	single = hog(2);
+	panic_on(syscall_sleep(FAIR_MS * MS));
+	work = counters[1] + counters[2];
+	debugf("%s: fork fairness: the single hog got %d%% of the CPU time, the %d forked ones %d%%\n",
+	       POLICY, counters[2] / (work / 100 + 1), NFORKED, counters[1] / (work / 100 + 1));
+	panic_on(syscall_env_destroy(single));
+	ipc_send(forker, 0, 0, 0);
+	ipc_recv(&who, 0, 0); // the exit status of the forker
+
+	debugf("sched_bench done\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := sleep_check
@@ -0,0 +1,78 @@
+// Timed sleep check: 'syscall_sleep' blocks for at least the requested time, sleeping envs are
+// not scheduled, and they wake up in order of their deadlines, also while the CPU is idle.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static void sleeper(u_int ms) {
+	if (fork() == 0) {
+		syscall_sleep(ms * MS);
+		exit(ms); // sends 'ms' to us
+	}
+}
+
+int main() {
+	uint64_t t0, t1;
+	u_int who, runs;
+	int child;
+
+	t0 = now();
+	for (int i = 0; i < 1000; i++) {
+		t1 = now();
+		if (t1 < t0) {
+			user_panic("the time went backwards");
+		}
+		t0 = t1;
+	}
+
+	t0 = now();
+	panic_on(syscall_sleep(MS));
+	t1 = now();
+	if (t1 - t0 < MS) {
+		user_panic("slept %d cycles, less than %d", (u_int)(t1 - t0), MS);
+	}
+	debugf("1 ms sleep took %d us\n", (u_int)(t1 - t0) / (KCLOCK_HZ / 1000000));
+
+	// A sleeping child is off the run queues.
+	if ((child = fork()) == 0) {
+		syscall_sleep(20 * MS);
+		exit(0);
+	}
+	syscall_sleep(5 * MS);
+	runs = envs[ENVX(child)].env_runs;
+	if (envs[ENVX(child)].env_status != ENV_NOT_RUNNABLE) {
+		user_panic("the sleeping child is runnable");
+	}
+	for (int i = 0; i < 100; i++) {
+		syscall_yield();
+	}
+	if (envs[ENVX(child)].env_runs != runs) {
+		user_panic("the sleeping child was scheduled");
+	}
+	ipc_recv(&who, 0, 0); // the exit status of the child
+
+	// Sleepers wake up in order, while we wait blocked, so the CPU is idle in between.
+	t0 = now();
+	sleeper(30);
+	sleeper(10);
+	sleeper(20);
+	for (u_int ms = 10; ms <= 30; ms += 10) {
+		if (ipc_recv(&who, 0, 0) != ms) {
+			user_panic("the %d ms sleeper woke up out of order", ms);
+		}
+		if (now() - t0 < ms * MS) {
+			user_panic("the %d ms sleeper woke up early", ms);
+		}
+	}
+
+	debugf("sleep_check() succeeded!\n");
+	return 0;
+}
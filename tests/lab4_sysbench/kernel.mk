@@ -0,0 +1 @@
+init-envs := syscall_bench
@@ -0,0 +1,45 @@
+// Syscall cost benchmark: CP0_COUNT cycles per call of syscalls taking the fast path (see
+// 'syscall_fast_table'), against one which saves and restores the full trapframe.
+
+#include <lib.h>
+
+#define ROUNDS 10000
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static void report(const char *what, uint64_t t0) {
+	debugf("%s: %d cycles per call\n", what, (u_int)(now() - t0) / ROUNDS);
+}
+
+int main() {
+	uint64_t t, t0;
+	u_int id = syscall_getenvid();
+
+	t0 = now();
+	for (int i = 0; i < ROUNDS; i++) {
+		if (syscall_getenvid() != id) {
+			user_panic("bad envid");
+		}
+	}
+	report("getenvid (fast)", t0);
+
+	t0 = now();
+	for (int i = 0; i < ROUNDS; i++) {
+		panic_on(syscall_gettime(&t));
+	}
+	report("gettime (fast)", t0);
+
+	t0 = now();
+	for (int i = 0; i < ROUNDS; i++) {
+		panic_on(syscall_set_priority(0, SCHED_LEVEL_DEFAULT));
+	}
+	report("set_priority (full)", t0);
+
+	debugf("syscall_bench done\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := sysstat_check
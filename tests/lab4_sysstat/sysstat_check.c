@@ -0,0 +1,65 @@
+// Syscall statistics check: calls on the full path, on the fast path, and blocking ones are
+// counted for the env and for all envs, and the histograms of both add up to the counts.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define CHECK_VA 0x20000000
+#define NCALLS 16
+
+static struct Sysstat a, b;
+
+static void expect(const char *what, u_int sysno, u_int calls) {
+	u_int env = b.ss_env[sysno].sc_count - a.ss_env[sysno].sc_count;
+	u_int all = b.ss_all[sysno].sc_count - a.ss_all[sysno].sc_count;
+	u_int hist = 0, env_hist = 0;
+
+	if (env != calls || all < calls) {
+		user_panic("%s: %d calls counted for us, %d for all, not %d", what, env, all, calls);
+	}
+	if (b.ss_env[sysno].sc_cycles <= a.ss_env[sysno].sc_cycles) {
+		user_panic("%s: no time counted", what);
+	}
+	for (int i = 0; i < SYSSTAT_NBUCKETS; i++) {
+		hist += b.ss_hist[sysno][i];
+		env_hist += b.ss_env_hist[sysno][i];
+	}
+	if (hist != b.ss_all[sysno].sc_count) {
+		user_panic("%s: %d calls in the histogram, %d counted", what, hist,
+			   b.ss_all[sysno].sc_count);
+	}
+	if (env_hist != b.ss_env[sysno].sc_count) {
+		user_panic("%s: %d calls in our histogram, %d counted", what, env_hist,
+			   b.ss_env[sysno].sc_count);
+	}
+}
+
+int main() {
+	int r;
+
+	if ((r = syscall_sysstat(0, &a)) == -E_NO_SYS) {
+		debugf("sysstat_check: built with 'MOS_SYSSTAT=n', nothing to check\n");
+		return 0;
+	}
+	panic_on(r);
+	for (int i = 0; i < NCALLS; i++) {
+		panic_on(syscall_mem_alloc(0, (void *)(CHECK_VA + i * PAGE_SIZE), PTE_D));
+		syscall_getenvid();
+	}
+	panic_on(syscall_sleep(MS));
+	panic_on(syscall_sysstat(0, &b));
+
+	expect("mem_alloc", SYS_mem_alloc, NCALLS);
+	expect("getenvid", SYS_getenvid, NCALLS);
+	expect("sleep", SYS_sleep, 1);
+	// The time we spent asleep is not counted.
+	if (b.ss_env[SYS_sleep].sc_cycles - a.ss_env[SYS_sleep].sc_cycles >= MS) {
+		user_panic("sleep: the time blocked is counted");
+	}
+	if (syscall_sysstat(0, (struct Sysstat *)UTOP) != -E_INVAL) {
+		user_panic("sysstat accepted a kernel buffer");
+	}
+
+	debugf("sysstat_check() succeeded!\n");
+	return 0;
+}
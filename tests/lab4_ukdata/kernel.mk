@@ -0,0 +1 @@
+init-envs := uk_check
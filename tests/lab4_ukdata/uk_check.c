@@ -0,0 +1,82 @@
+// Kernel data page check: what 'ukdata' reports matches the syscalls it replaces, in a forked
+// child too, and reading it is cheaper than trapping.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define NREADS 1000
+#define NHOGS 2
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+int main() {
+	uint64_t t0, t1, t2;
+	u_int ticks, who;
+	int child, hogs[NHOGS];
+
+	if (uk_getenvid() != syscall_getenvid()) {
+		user_panic("ukdata: envid %x, syscall: %x", uk_getenvid(), syscall_getenvid());
+	}
+	if ((child = fork()) == 0) {
+		if (uk_getenvid() != syscall_getenvid() || env->env_id != syscall_getenvid()) {
+			user_panic("child: ukdata envid %x, syscall: %x", uk_getenvid(),
+				   syscall_getenvid());
+		}
+		return 0;
+	}
+	ipc_recv(&who, 0, 0); // the exit status of the child
+	if (who != child) {
+		user_panic("exit status from %x, not the child %x", who, child);
+	}
+
+	// The clock only moves forward, and never ahead of the real time.
+	t0 = uk_clock();
+	t1 = now();
+	if (t0 > t1) {
+		user_panic("ukdata clock ahead of the real time");
+	}
+	ticks = ukdata->uk_ticks;
+	panic_on(syscall_sleep(20 * MS));
+	if (uk_clock() < t1 + 20 * MS || ukdata->uk_ticks == ticks) {
+		user_panic("ukdata not updated across a sleep");
+	}
+
+	// Runnable hogs raise the load average.
+	for (int i = 0; i < NHOGS; i++) {
+		if ((hogs[i] = fork()) == 0) {
+			for (;;) {
+			}
+		}
+	}
+	panic_on(syscall_sleep(1000 * MS));
+	if (ukdata->uk_runnable < NHOGS || ukdata->uk_loadavg < (1 << UK_LOAD_SHIFT)) {
+		user_panic("runnable %d, load average %d with %d hogs", ukdata->uk_runnable,
+			   ukdata->uk_loadavg, NHOGS);
+	}
+	debugf("load average with %d hogs: %d/%d\n", NHOGS, ukdata->uk_loadavg, 1 << UK_LOAD_SHIFT);
+	for (int i = 0; i < NHOGS; i++) {
+		panic_on(syscall_env_destroy(hogs[i]));
+	}
+
+	t0 = now();
+	for (int i = 0; i < NREADS; i++) {
+		uk_getenvid();
+		uk_clock();
+	}
+	t1 = now();
+	for (int i = 0; i < NREADS; i++) {
+		syscall_getenvid();
+		now();
+	}
+	t2 = now();
+	debugf("envid and time: %d cycles from ukdata, %d cycles by syscalls\n",
+	       (u_int)(t1 - t0) / NREADS, (u_int)(t2 - t1) / NREADS);
+
+	debugf("uk_check() succeeded!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := zero_bench
@@ -0,0 +1,98 @@
+// Sparse access benchmark: read one word of every page of a large untouched region, then write to
+// a few of them, and compare the resident set with what allocating a page on every first touch
+// would take. Reads map the shared zero page, only written pages get memory of their own.
+
+#include <lib.h>
+
+#define SPARSE_VA 0x20000000
+#define SPARSE_PAGES 4096 // 16 MiB
+#define WRITE_STRIDE 64
+
+static volatile u_int *page(u_int i) {
+	return (volatile u_int *)(SPARSE_VA + i * PAGE_SIZE);
+}
+
+static u_int pa(u_int i) {
+	return PTE_ADDR(vpt[VPN(page(i))]);
+}
+
+// Count the mapped pages of the region, and how many of them are the zero page.
+static u_int rss(u_int zero_pa, u_int *zero) {
+	u_int n = 0;
+
+	*zero = 0;
+	for (u_int i = 0; i < SPARSE_PAGES; i++) {
+		if (!(vpd[PDX(page(i))] & PTE_V) || !(vpt[VPN(page(i))] & PTE_V)) {
+			continue;
+		}
+		if (pa(i) == zero_pa) {
+			(*zero)++;
+		} else {
+			n++;
+		}
+	}
+	return n;
+}
+
+static void report(const char *what, u_int touched, u_int zero_pa) {
+	u_int zero, n = rss(zero_pa, &zero);
+
+	debugf("%s: %d pages touched, RSS %d pages (%d KiB) + %d zero page mappings; "
+	       "allocating on first touch: %d pages (%d KiB)\n",
+	       what, touched, n, n * PAGE_SIZE / 1024, zero, touched, touched * PAGE_SIZE / 1024);
+}
+
+int main() {
+	u_int i, sum = 0, zero_pa, who;
+	int child;
+
+	// Sparse reads: all of them map the same read-only page.
+	for (i = 0; i < SPARSE_PAGES; i++) {
+		sum += page(i)[i % (PAGE_SIZE / 4)];
+	}
+	if (sum != 0) {
+		user_panic("untouched memory is not zero");
+	}
+	zero_pa = pa(0);
+	for (i = 0; i < SPARSE_PAGES; i++) {
+		if (pa(i) != zero_pa || !(vpt[VPN(page(i))] & PTE_COW) || (vpt[VPN(page(i))] & PTE_D)) {
+			user_panic("page %d is not the zero page", i);
+		}
+	}
+	report("after reads", SPARSE_PAGES, zero_pa);
+
+	// Writes: only the written pages get a private copy.
+	for (i = 0; i < SPARSE_PAGES; i += WRITE_STRIDE) {
+		page(i)[1] = i;
+	}
+	for (i = 0; i < SPARSE_PAGES; i++) {
+		int written = i % WRITE_STRIDE == 0;
+		if ((pa(i) == zero_pa) == written || page(i)[1] != (written ? i : 0)) {
+			user_panic("page %d after writes: pa %x value %x", i, pa(i), page(i)[1]);
+		}
+	}
+	report("after writes", SPARSE_PAGES, zero_pa);
+
+	// A write by the kernel gets a private copy too.
+	syscall_ksm_ctl(-1, (struct Ksm_info *)page(1));
+	if (pa(1) == zero_pa) {
+		user_panic("kernel write to the zero page");
+	}
+
+	// After fork, the zero page is still shared and copied on write in both envs.
+	if ((child = fork()) == 0) {
+		if (pa(2) != zero_pa) {
+			user_panic("child: page 2 is not the zero page");
+		}
+		page(2)[0] = 0xc0ffee;
+		ipc_send(env->env_parent_id, page(2)[0], 0, 0);
+		return 0;
+	}
+	if (ipc_recv(&who, 0, 0) != 0xc0ffee || page(2)[0] != 0 || pa(2) != zero_pa) {
+		user_panic("parent: the child's write to the zero page leaked");
+	}
+	ipc_recv(&who, 0, 0); // the exit status of the child
+
+	debugf("zero_bench done\n");
+	return 0;
+}
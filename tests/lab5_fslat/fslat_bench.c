@@ -0,0 +1,72 @@
+// fs latency benchmark: time open/close round trips to the fs server while CPU-bound envs run,
+// first with the hogs at the same level as the server, then with the hogs at the default level.
+// Besides the time, we report the loop iterations done by the hogs meanwhile.
+
+#include <lib.h>
+
+#define HOG_VA 0x20000000
+#define NHOGS 3
+#define NROUNDS 32
+
+static volatile u_int *hog_work = (volatile u_int *)HOG_VA;
+
+static u_int work(void) {
+	u_int sum = 0;
+
+	for (int i = 0; i < NHOGS; i++) {
+		sum += hog_work[i];
+	}
+	return sum;
+}
+
+static u_int measure(const char *what) {
+	u_int start, n, us;
+	uint64_t t0, t1;
+	int fd;
+
+	panic_on(syscall_gettime(&t0));
+	start = work();
+	for (int i = 0; i < NROUNDS; i++) {
+		if ((fd = open("/motd", O_RDONLY)) < 0) {
+			user_panic("open /motd: %d", fd);
+		}
+		close(fd);
+	}
+	n = (work() - start) / NROUNDS;
+	panic_on(syscall_gettime(&t1));
+	us = (u_int)(t1 - t0) / NROUNDS / (KCLOCK_HZ / 1000000);
+	debugf("%s: %d us and %d hog iterations per open/close round trip\n", what, us, n);
+	return us;
+}
+
+int main() {
+	u_int hogs[NHOGS], flat, prio;
+	int i, r;
+
+	panic_on(syscall_set_priority(0, SCHED_LEVEL_SERVER));
+	panic_on(syscall_mem_alloc(0, (void *)HOG_VA, PTE_D | PTE_LIBRARY));
+	for (i = 0; i < NHOGS; i++) {
+		if ((r = fork()) == 0) {
+			for (;;) {
+				hog_work[i]++;
+			}
+		}
+		hogs[i] = r;
+	}
+
+	// The hogs inherited our level, which is also the level of the fs server.
+	flat = measure("hogs at the server level");
+
+	for (i = 0; i < NHOGS; i++) {
+		panic_on(syscall_set_priority(hogs[i], SCHED_LEVEL_DEFAULT));
+	}
+	prio = measure("hogs at the default level");
+
+	debugf("round trip latency: %d%% of the single-level one\n",
+	       prio * 100 / (flat == 0 ? 1 : flat));
+	for (i = 0; i < NHOGS; i++) {
+		syscall_env_destroy(hogs[i]);
+	}
+	debugf("fslat_bench done\n");
+	return 0;
+}
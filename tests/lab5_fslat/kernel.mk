@@ -0,0 +1,2 @@
+init-envs += fslat_bench /fs_serv
+fs-files  += $(wildcard $(test_dir)/rootfs/*)
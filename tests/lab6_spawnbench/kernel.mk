@@ -0,0 +1 @@
+init-envs += spawn_bench /fs_serv
@@ -0,0 +1,119 @@
+// Spawn benchmark: the time to spawn a program and wait for it with 'spawn' (the image loaded by
+// the kernel in one syscall) against 'uspawn' (loaded page by page from user space), and the
+// memory used by concurrent shells, whose text 'spawn' maps from the file server's block cache.
+
+#include <lib.h>
+
+#define MS (KCLOCK_HZ / 1000)
+#define NROUNDS 20
+#define NSHELLS 10
+#define PEEK_VA 0x30000000
+
+static uint64_t now(void) {
+	uint64_t t;
+
+	panic_on(syscall_gettime(&t));
+	return t;
+}
+
+static u_int us(uint64_t cycles) {
+	return (u_int)(cycles >> 2) / (MS / 4000);
+}
+
+static u_int bench(const char *name, int (*spawn_fn)(char *, char **)) {
+	char *argv[] = {"echo", NULL};
+	uint64_t t0 = now();
+	int child;
+
+	for (int i = 0; i < NROUNDS; i++) {
+		if ((child = spawn_fn("/echo.b", argv)) < 0) {
+			user_panic("%s: %d", name, child);
+		}
+		wait(child);
+	}
+	return us(now() - t0) / NROUNDS;
+}
+
+static u_int free_pages(void) {
+	struct Mem_stat ms;
+
+	panic_on(syscall_mem_stat(0, &ms));
+	return ms.ms_free;
+}
+
+// Return whether the first page of text of 'child', running /sh.b, is the file server's cache
+// page of the first block of /sh.b.
+static int text_shared(int child) {
+	void *block;
+	int fd, shared;
+
+	if ((fd = open("/sh.b", O_RDONLY)) < 0 || read_map(fd, 0, &block) < 0) {
+		user_panic("cannot map /sh.b");
+	}
+	panic_on(syscall_mem_map(child, (void *)UTEXT, 0, (void *)PEEK_VA, PTE_V));
+	shared = PTE_ADDR(vpt[VPN(PEEK_VA)]) == PTE_ADDR(vpt[VPN(block)]);
+	panic_on(syscall_mem_unmap(0, (void *)PEEK_VA));
+	close(fd);
+	return shared;
+}
+
+// Return the pages used by each of 'NSHELLS' shells, which block reading their input, a pipe.
+static u_int shells(const char *name, int (*spawn_fn)(char *, char **)) {
+	char *argv[] = {"sh", NULL};
+	int kids[NSHELLS];
+	u_int before;
+	uint64_t t0;
+
+	before = free_pages();
+	t0 = now();
+	for (int i = 0; i < NSHELLS; i++) {
+		if ((kids[i] = spawn_fn("/sh.b", argv)) < 0) {
+			user_panic("%s sh: %d", name, kids[i]);
+		}
+	}
+	t0 = now() - t0;
+	panic_on(syscall_sleep(100 * MS));
+	before -= free_pages();
+	if (text_shared(kids[0]) != (spawn_fn == spawn)) {
+		user_panic("%s: the text of the shells is %sshared with the block cache", name,
+			   spawn_fn == spawn ? "not " : "");
+	}
+	for (int i = 0; i < NSHELLS; i++) {
+		panic_on(syscall_env_destroy(kids[i]));
+	}
+	debugf("%s: %d shells in %d us, %d pages each\n", name, NSHELLS, us(t0),
+	       before / NSHELLS);
+	return before / NSHELLS;
+}
+
+int main() {
+	char *argv[] = {"testarg", "one", "two", NULL};
+	int child, p[2];
+
+	// Both pass the arguments the same way.
+	if ((child = spawn("/testarg.b", argv)) < 0) {
+		user_panic("spawn testarg: %d", child);
+	}
+	wait(child);
+	if ((child = uspawn("/testarg.b", argv)) < 0) {
+		user_panic("uspawn testarg: %d", child);
+	}
+	wait(child);
+	if (spawn("/not_exist.b", argv) >= 0 || spawn("/motd", argv) != -E_NOT_EXEC) {
+		user_panic("spawn of a missing or non-executable file succeeded");
+	}
+
+	debugf("spawn: %d us per program, uspawn: %d us\n", bench("spawn", spawn),
+	       bench("uspawn", uspawn));
+
+	// Nothing else is open: the shells read fd 0, the pipe, and have no fd 1 to write to.
+	if (pipe(p) < 0 || p[0] != 0 || dup(p[1], 2) < 0 || close(p[1]) < 0) {
+		user_panic("cannot set up the input of the shells");
+	}
+	shells("spawn", spawn);
+	shells("uspawn", uspawn);
+	close(0);
+	close(2);
+	debugf("spawn_bench done\n");
+	return 0;
+}
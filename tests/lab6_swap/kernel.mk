@@ -0,0 +1 @@
+init-envs := swap_bench
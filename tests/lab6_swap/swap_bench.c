@@ -0,0 +1,54 @@
+// Memory pressure benchmark: touch a working set larger than the 64 MiB of RAM, so that the
+// kernel has to swap pages out to (and back in from) the swap disk.
+
+#include <lib.h>
+
+#define BENCH_VA 0x20000000
+#define BENCH_PAGES (72 * 1024 * 1024 / PAGE_SIZE)
+#define ROUNDS 3
+
+static void report(const char *what) {
+	struct Swap_info si;
+
+	if (syscall_swap_info(&si) < 0 || si.si_slots == 0) {
+		user_panic("no swap disk");
+	}
+	debugf("%s: pageouts %d pageins %d writes %d scanned %d slots used %d/%d\n", what,
+	       si.si_pageouts, si.si_pageins, si.si_writes, si.si_scanned, si.si_used, si.si_slots);
+}
+
+int main() {
+	u_int i, round, stride;
+	u_int *p;
+
+	debugf("swap_bench: %d pages (%d KiB) working set, %d rounds\n", BENCH_PAGES,
+	       BENCH_PAGES * PAGE_SIZE / 1024, ROUNDS);
+
+	// Sequential sweeps: every page is written once per round and checked in the next one.
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < BENCH_PAGES; i++) {
+			p = (u_int *)(BENCH_VA + i * PAGE_SIZE);
+			if (round > 0 && (p[0] != i * ROUNDS + round - 1 || p[PAGE_SIZE / 4 - 1] != i)) {
+				user_panic("page %d corrupted in round %d: %x %x", i, round, p[0],
+					   p[PAGE_SIZE / 4 - 1]);
+			}
+			p[0] = i * ROUNDS + round;
+			p[PAGE_SIZE / 4 - 1] = i;
+		}
+		report("sequential round");
+	}
+
+	// Strided reads: no locality at all, every access may have to swap a page in.
+	stride = 7919; // prime, so that all pages are visited
+	for (i = 0; i < BENCH_PAGES; i++) {
+		u_int n = (i * stride) % BENCH_PAGES;
+		p = (u_int *)(BENCH_VA + n * PAGE_SIZE);
+		if (p[0] != n * ROUNDS + ROUNDS - 1) {
+			user_panic("page %d corrupted in strided read: %x", n, p[0]);
+		}
+	}
+	report("strided round");
+
+	debugf("swap_bench: ok\n");
+	return 0;
+}
@@ -3,18 +3,34 @@
 #include <args.h>
 #include <env.h>
 #include <fd.h>
+#include <kclock.h>
+#include <kmem.h>
+#include <ksm.h>
+#include <swap.h>
+#include <sync.h>
+#include <sched.h>
 #include <mmu.h>
 #include <pmap.h>
 #include <syscall.h>
+#include <sysstat.h>
 #include <trap.h>
 
 #define vpt ((const volatile Pte *)UVPT)
 #define vpd ((const volatile Pde *)(UVPT + (PDX(UVPT) << PGSHIFT)))
 #define envs ((const volatile struct Env *)UENVS)
 #define pages ((const volatile struct Page *)UPAGES)
+#define ukdata ((const volatile struct Ukdata *)UKDATA)
 
 // libos
 void exit(int status) __attribute__((noreturn));
+void poll_wait(u_int *delay);
+u_int cycles_to_ms(uint64_t cycles);
+u_int uk_getenvid(void);
+uint64_t uk_clock(void);
+
+// Delays of 'poll_wait', in CP0_COUNT cycles.
+#define POLL_MIN_DELAY (KCLOCK_HZ / 100000) // 10 us
+#define POLL_MAX_DELAY TIMER_INTERVAL
 
 extern const volatile struct Env *env;
 
@@ -40,8 +56,10 @@ void _user_halt(const char *, int, const char *, ...) __attribute__((noreturn));
 
 /// fork, spawn
 int spawn(char *prog, char **argv);
+int uspawn(char *prog, char **argv);
 int spawnl(char *prot, char *args, ...);
 int fork(void);
+int ufork(void);
 
 /// syscalls
 extern int msyscall(int, ...);
@@ -78,10 +96,47 @@ int syscall_get_var(const char *name, char *value, int bufsize);
 int syscall_get_all_var(char *buf, int bufsize);
 int syscall_alloc_shell_id(void);
 int syscall_get_parent_id(u_int);
+int syscall_kmem_info(struct Kmem_info *buf, u_int n);
+int syscall_swap_info(struct Swap_info *buf);
+int syscall_ksm_ctl(int rate, struct Ksm_info *buf);
+int syscall_mem_stat(u_int envid, struct Mem_stat *buf);
+int syscall_set_priority(u_int envid, u_int level);
+int syscall_sleep(u_int cycles);
+int syscall_gettime(uint64_t *buf);
+int syscall_futex_wait(volatile u_int *addr, u_int expected);
+int syscall_futex_wake(volatile u_int *addr, u_int n);
+int syscall_multicall(struct Multicall *calls, u_int n);
+int syscall_mem_alloc_range(u_int envid, void *va, u_int npages, u_int perm);
+int syscall_mem_map_range(u_int srcid, void *srcva, u_int dstid, void *dstva, u_int npages,
+			  u_int perm);
+int syscall_mem_unmap_range(u_int envid, void *va, u_int npages);
+int syscall_fork(void);
+int syscall_spawn(const void *image, u_int size, char **argv, const struct Fd *fd);
+int syscall_sysstat(u_int envid, struct Sysstat *buf);
+int syscall_ipc_call(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva);
+int syscall_ipc_reply_and_recv(u_int envid, u_int value, const void *srcva, u_int perm,
+			       void *dstva);
+int syscall_ipc_send(u_int envid, u_int value, const void *srcva, u_int perm);
+
+// multicall.c
+// Syscalls queued to be run together by 'syscall_multicall'.
+struct Multicall_batch {
+	struct Multicall mb_calls[MULTICALL_MAX];
+	u_int mb_n;    // number of queued syscalls
+	u_int mb_done; // number of syscalls which succeeded in the last run
+};
+
+void multicall_init(struct Multicall_batch *b);
+int multicall_add(struct Multicall_batch *b, u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4,
+		  u_int a5);
+int multicall_flush(struct Multicall_batch *b);
 
 // ipc.c
 void ipc_send(u_int whom, u_int val, const void *srcva, u_int perm);
 u_int ipc_recv(u_int *whom, void *dstva, u_int *perm);
+u_int ipc_call(u_int whom, u_int val, const void *srcva, u_int perm, void *dstva, u_int *rperm);
+u_int ipc_reply_and_recv(u_int whom, u_int val, const void *srcva, u_int perm, u_int *from,
+			 void *dstva, u_int *rperm);
 
 // wait.c
 int wait(u_int envid);
@@ -0,0 +1,42 @@
+#ifndef _USER_SYNC_H_
+#define _USER_SYNC_H_ 1
+
+#include <types.h>
+
+/*
+ * Locks, condition variables and semaphores built on 'syscall_futex_wait' and
+ * 'syscall_futex_wake'. To synchronise envs, they must live in memory all of them map with
+ * 'PTE_LIBRARY'. Zero-filled memory holds an unlocked mutex, a condition variable and a
+ * semaphore with the value 0.
+ */
+
+// 0: unlocked, 1: locked, 2: locked and there may be waiters.
+struct Mutex {
+	volatile u_int m_state;
+};
+
+struct Cond {
+	volatile u_int c_seq; // incremented on every signal
+};
+
+struct Sem {
+	volatile u_int s_value;
+	volatile u_int s_waiters;
+};
+
+void mutex_init(struct Mutex *m);
+void mutex_lock(struct Mutex *m);
+int mutex_trylock(struct Mutex *m);
+void mutex_unlock(struct Mutex *m);
+
+void cond_init(struct Cond *c);
+void cond_wait(struct Cond *c, struct Mutex *m);
+void cond_signal(struct Cond *c);
+void cond_broadcast(struct Cond *c);
+
+void sem_init(struct Sem *s, u_int value);
+void sem_wait(struct Sem *s);
+int sem_trywait(struct Sem *s);
+void sem_post(struct Sem *s);
+
+#endif
@@ -0,0 +1,44 @@
+#include <lib.h>
+
+static void usage(void)
+{
+	printf("usage: ksm [pages-per-tick]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct Ksm_info ks;
+	int rate = -1;
+
+	if (argc > 2)
+	{
+		usage();
+	}
+	if (argc == 2)
+	{
+		rate = 0;
+		for (char *p = argv[1]; *p; p++)
+		{
+			if (*p < '0' || *p > '9')
+			{
+				usage();
+			}
+			rate = rate * 10 + *p - '0';
+		}
+	}
+
+	int r = syscall_ksm_ctl(rate, &ks);
+	if (r < 0)
+	{
+		printf("ksm: %d\n", r);
+		return 1;
+	}
+
+	printf("ksm: %d pages per tick, %d passes\n", ks.ks_rate, ks.ks_runs);
+	printf("last pass: %d pages scanned, %d merged\n", ks.ks_scanned, ks.ks_merged);
+	printf("%d shared pages used by %d more mappings: %d pages (%d KiB) saved\n", ks.ks_shared,
+	       ks.ks_sharing, ks.ks_sharing, ks.ks_sharing * PAGE_SIZE / 1024);
+	printf("%d mappings of the zero page\n", ks.ks_zero);
+	return 0;
+}
@@ -42,13 +42,14 @@ int opencons(void) {
 
 int cons_read(struct Fd *fd, void *vbuf, u_int n, u_int offset) {
 	int c;
+	u_int delay = POLL_MIN_DELAY;
 
 	if (n == 0) {
 		return 0;
 	}
 
 	while ((c = syscall_cgetc()) == 0) {
-		syscall_yield();
+		poll_wait(&delay);
 	}
 
 	if (c != '\r') {
@@ -116,11 +116,9 @@ int file_close(struct Fd *fd) {
 	if (size == 0) {
 		return 0;
 	}
-	for (i = 0; i < size; i += PTMAP) {
-		if ((r = syscall_mem_unmap(0, (void *)(va + i))) < 0) {
-			debugf("cannont unmap the file\n");
-			return r;
-		}
+	if ((r = syscall_mem_unmap_range(0, (void *)va, ROUND(size, PTMAP) / PTMAP)) < 0) {
+		debugf("cannont unmap the file\n");
+		return r;
 	}
 	return 0;
 }
@@ -260,10 +258,10 @@ int ftruncate(int fdnum, u_int size) {
 	}
 
 	// Unmap pages if truncating the file
-	for (i = ROUND(size, PTMAP); i < ROUND(oldsize, PTMAP); i += PTMAP) {
-		if ((r = syscall_mem_unmap(0, (void *)(va + i))) < 0) {
-			user_panic("ftruncate: syscall_mem_unmap %08x: %d\n", va + i, r);
-		}
+	i = ROUND(size, PTMAP);
+	if (i < ROUND(oldsize, PTMAP) &&
+	    (r = syscall_mem_unmap_range(0, (void *)(va + i), (ROUND(oldsize, PTMAP) - i) / PTMAP)) < 0) {
+		user_panic("ftruncate: syscall_mem_unmap_range %08x: %d\n", va + i, r);
 	}
 
 	return 0;
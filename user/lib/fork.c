@@ -54,6 +54,16 @@ static void __attribute__((noreturn)) cow_entry(struct Trapframe *tf)
 	user_panic("syscall_set_trapframe returned %d", r);
 }
 
+// Map our page at 'va' at the same address in 'envid' with 'perm', now or queued in 'b'.
+static int dupmap(struct Multicall_batch *b, u_int va, u_int envid, u_int perm)
+{
+	if (b == NULL)
+	{
+		return syscall_mem_map(0, (void *)va, envid, (void *)va, perm);
+	}
+	return multicall_add(b, SYS_mem_map, 0, va, envid, va, perm);
+}
+
 /* Overview:
  *   Grant our child 'envid' access to the virtual page 'vpn' (with address 'vpn' * 'PAGE_SIZE') in
  * our (current env's) address space. 'PTE_COW' should be used to isolate the modifications on
@@ -74,8 +84,11 @@ static void __attribute__((noreturn)) cow_entry(struct Trapframe *tf)
  *     kernel 'envid2env' converts '0' to 'curenv').
  *   - You should use 'syscall_mem_map', the user space wrapper around 'msyscall' to invoke
  *     'sys_mem_map' in kernel.
+ *
+ *   If 'b' is not NULL, the mappings are queued in it and made when it's run: the child gets the
+ *   page as it is then, so we must not write to it in between.
  */
-static void duppage(u_int envid, u_int vpn)
+static void duppage(struct Multicall_batch *b, u_int envid, u_int vpn)
 {
 	int r;
 	u_int addr;
@@ -92,14 +105,15 @@ static void duppage(u_int envid, u_int vpn)
 	/* Hint: The page should be first mapped to the child before remapped in the parent. (Why?)
 	 */
 	/* Exercise 4.10: Your code here. (2/2) */
-	if ((perm & PTE_D) && !(perm & PTE_LIBRARY) && !(perm & PTE_COW))
+	if ((perm & (PTE_D | PTE_COW)) && !(perm & PTE_LIBRARY))
 	{
-		r = syscall_mem_map(0, (void *)addr, envid, (void *)addr, (perm & ~PTE_D) | PTE_COW);
+		perm = (perm & ~PTE_D) | PTE_COW;
+		r = dupmap(b, addr, envid, perm);
 		if (r < 0)
 		{
 			user_panic("user panic in duppage mem_map and error code: %d", r);
 		}
-		r = syscall_mem_map(0, (void *)addr, 0, (void *)addr, (perm & ~PTE_D) | PTE_COW);
+		r = dupmap(b, addr, 0, perm);
 		if (r < 0)
 		{
 			user_panic("user panic in duppage mem_map and error code: %d", r);
@@ -107,7 +121,7 @@ static void duppage(u_int envid, u_int vpn)
 	}
 	else
 	{
-		r = syscall_mem_map(0, (void *)addr, envid, (void *)addr, perm);
+		r = dupmap(b, addr, envid, perm);
 		if (r < 0)
 		{
 			user_panic("user panic in duppage mem_map and error code: %d", r);
@@ -115,21 +129,42 @@ static void duppage(u_int envid, u_int vpn)
 	}
 }
 
+// 'duppage' the page 'vpn' if it's mapped, faulting it back in first if it's swapped out, so that
+// it can be shared with the child.
+static void dupvpn(struct Multicall_batch *b, u_int envid, u_int vpn)
+{
+	if (!(vpd[PDX(vpn << PGSHIFT)] & PTE_V))
+	{
+		return;
+	}
+	if (vpt[vpn] & PTE_SWAP)
+	{
+		(void)*(volatile u_char *)(vpn << PGSHIFT);
+	}
+	if (vpt[vpn] & PTE_V)
+	{
+		duppage(b, envid, vpn);
+	}
+}
+
 /* Overview:
  *   User-level 'fork'. Create a child and then copy our address space.
  *   Set up ours and its TLB Mod user exception entry to 'cow_entry'.
+ *   'fork' does the same with a single syscall; this one is kept to compare them.
  *
  * Post-Conditon:
  *   Child's 'env' is properly set.
  *
  * Hint:
  *   Use global symbols 'env', 'vpt' and 'vpd'.
- *   Use 'syscall_set_tlb_mod_entry', 'syscall_getenvid', 'syscall_exofork',  and 'duppage'.
+ *   Use 'syscall_set_tlb_mod_entry', 'uk_getenvid', 'syscall_exofork',  and 'duppage'.
  */
-int fork(void)
+int ufork(void)
 {
+	struct Multicall_batch b;
 	u_int child;
-	u_int i;
+	u_int i, sp;
+	int r;
 
 	/* Step 1: Set our TLB Mod user exception entry to 'cow_entry' if not done yet. */
 	if (env->env_user_tlb_mod_entry != (u_int)cow_entry)
@@ -143,13 +178,21 @@ int fork(void)
 	child = syscall_exofork();
 	if (child == 0)
 	{
-		env = envs + ENVX(syscall_getenvid());
+		env = envs + ENVX(uk_getenvid());
 		return 0;
 	}
 
 	/* Step 3: Map all mapped pages below 'USTACKTOP' into the child's address space. */
 	// Hint: You should use 'duppage'.
 	/* Exercise 4.15: Your code here. (1/2) */
+	// Our live stack is mapped right away, as we keep writing to it (to 'b' at least); those
+	// writes then copy it. The rest is not written to until the batch is run.
+	asm volatile("move %0, $sp" : "=r"(sp));
+	for (i = VPN(sp); i < VPN(USTACKTOP); i++)
+	{
+		dupvpn(NULL, child, i);
+	}
+	multicall_init(&b);
 	for (i = 0; i < PDX(UXSTACKTOP); i++)
 	{
 		if (vpd[i] & PTE_V)
@@ -158,13 +201,11 @@ int fork(void)
 			for (u_int j = 0; j < npage; j++)
 			{
 				u_int vpn = i * npage + j;
-				if (vpn << PGSHIFT >= USTACKTOP)
+				if (vpn >= VPN(sp))
 				{
 					break;
 				}
-				if (vpt[vpn] & PTE_V) {
-					duppage(child, vpn);
-				}
+				dupvpn(&b, child, vpn);
 			}
 		}
 	}
@@ -176,8 +217,38 @@ int fork(void)
 	 *   Child's TLB Mod user exception entry should handle COW, so set it to 'cow_entry'
 	 */
 	/* Exercise 4.15: Your code here. (2/2) */
-	syscall_set_tlb_mod_entry(child, cow_entry);
-	syscall_set_env_status(child, ENV_RUNNABLE);
+	/* The last mappings are made in the same trap. */
+	if ((r = multicall_add(&b, SYS_set_tlb_mod_entry, child, (u_int)cow_entry, 0, 0, 0)) < 0 ||
+	    (r = multicall_add(&b, SYS_set_env_status, child, ENV_RUNNABLE, 0, 0, 0)) < 0 ||
+	    (r = multicall_flush(&b)) < 0)
+	{
+		user_panic("fork: cannot set up the child: %d", r);
+	}
+
+	return child;
+}
+
+/* Overview:
+ *   Create a child sharing our address space copy-on-write, like 'ufork', but with the page
+ *   tables copied by the kernel in one pass ('syscall_fork'). Both envs handle their
+ *   copy-on-write faults in 'cow_entry'.
+ *
+ * Post-Conditon:
+ *   Child's 'env' is properly set.
+ */
+int fork(void)
+{
+	int child;
+
+	if (env->env_user_tlb_mod_entry != (u_int)cow_entry)
+	{
+		try(syscall_set_tlb_mod_entry(0, cow_entry));
+	}
 
+	child = syscall_fork();
+	if (child == 0)
+	{
+		env = envs + ENVX(uk_getenvid());
+	}
 	return child;
 }
@@ -4,16 +4,11 @@
 #include <lib.h>
 #include <mmu.h>
 
-// Send val to whom.  This function keeps trying until
-// it succeeds.  It should panic() on any error other than
-// -E_IPC_NOT_RECV.
-//
-// Hint: use syscall_yield() to be CPU-friendly.
+// Send val to whom.  If whom is not receiving, we are blocked
+// in the kernel, queued behind its other senders, until it
+// takes our message.  It should panic() on any error.
 void ipc_send(u_int whom, u_int val, const void *srcva, u_int perm) {
-	int r;
-	while ((r = syscall_ipc_try_send(whom, val, srcva, perm)) == -E_IPC_NOT_RECV) {
-		syscall_yield();
-	}
+	int r = syscall_ipc_send(whom, val, srcva, perm);
 	user_assert(r == 0);
 }
 
@@ -37,3 +32,42 @@ u_int ipc_recv(u_int *whom, void *dstva, u_int *perm) {
 
 	return env->env_ipc_value;
 }
+
+// Send val to whom and wait for its reply, like 'ipc_send' followed by 'ipc_recv', but in one
+// syscall. Only whom can send to us until it replies. Return the value of the reply and store
+// the permission of its page in *rperm.
+u_int ipc_call(u_int whom, u_int val, const void *srcva, u_int perm, void *dstva, u_int *rperm) {
+	int r = syscall_ipc_call(whom, val, srcva, perm, dstva);
+	user_assert(r == 0);
+
+	if (rperm) {
+		*rperm = env->env_ipc_perm;
+	}
+
+	return env->env_ipc_value;
+}
+
+// Reply val to whom (if not 0), then receive the next message like 'ipc_recv', storing its
+// sender in *from, in one syscall. We never block on whom: a reply to an env which is gone, or
+// isn't waiting for it in 'ipc_call' (it sent with 'ipc_send', or was interrupted), is dropped,
+// so that a server can't be stalled by one of its clients.
+u_int ipc_reply_and_recv(u_int whom, u_int val, const void *srcva, u_int perm, u_int *from,
+			 void *dstva, u_int *rperm) {
+	int r = syscall_ipc_reply_and_recv(whom, val, srcva, perm, dstva);
+	if (r == -E_IPC_NOT_RECV || r == -E_BAD_ENV) {
+		r = syscall_ipc_recv(dstva);
+	}
+	if (r != 0) {
+		user_panic("syscall_ipc_reply_and_recv err: %d", r);
+	}
+
+	if (from) {
+		*from = env->env_ipc_from;
+	}
+
+	if (rperm) {
+		*rperm = env->env_ipc_perm;
+	}
+
+	return env->env_ipc_value;
+}
@@ -8,7 +8,7 @@ void exit(int status)
 #if !defined(LAB) || LAB >= 5
 	close_all();
 #endif
-	u_int parent_id = syscall_get_parent_id(0);
+	u_int parent_id = env->env_parent_id;
 	// 如果父进程存在，则通过IPC发送返回值
 	if (parent_id != 0)
 	{
@@ -18,13 +18,62 @@ void exit(int status)
 	user_panic("unreachable code");
 }
 
+/* Overview:
+ *   Convert CP0_COUNT cycles (as in 'syscall_gettime' and the CPU times in 'envs') to
+ *   milliseconds, saturating at ~0.
+ */
+u_int cycles_to_ms(uint64_t cycles)
+{
+	// 'KCLOCK_HZ / 1000' is 100000 = 32 * 3125. Shift first to stay in 32 bits.
+	uint64_t c = cycles >> 5;
+
+	return (c >> 32) ? ~0u : (u_int)c / 3125;
+}
+
+/* Overview:
+ *   Sleep while polling for something to happen. '*delay' starts at 'POLL_MIN_DELAY' and
+ *   doubles on every call, up to 'POLL_MAX_DELAY'.
+ */
+void poll_wait(u_int *delay)
+{
+	syscall_sleep(*delay);
+	*delay = MIN(*delay * 2, POLL_MAX_DELAY);
+}
+
+/* Overview:
+ *   Return our envid, read from 'ukdata' without a syscall: 'uk_curenv' is set to us whenever
+ *   the kernel returns to us.
+ */
+u_int uk_getenvid(void)
+{
+	return ukdata->uk_curenv;
+}
+
+/* Overview:
+ *   Return the time (in CP0_COUNT cycles since boot) when the kernel last returned to us, read
+ *   from 'ukdata' without a syscall. It lags behind 'syscall_gettime' by at most the time we have
+ *   run since, i.e. a clock tick unless interrupts are masked.
+ */
+uint64_t uk_clock(void)
+{
+	u_int seq;
+	uint64_t clock;
+
+	do
+	{
+		seq = ukdata->uk_seq;
+		clock = ukdata->uk_clock;
+	} while ((seq & 1) || seq != ukdata->uk_seq);
+	return clock;
+}
+
 const volatile struct Env *env;
 extern int main(int, char **);
 
 void libmain(int argc, char **argv)
 {
 	// set env to point at our env structure in envs[].
-	env = &envs[ENVX(syscall_getenvid())];
+	env = &envs[ENVX(uk_getenvid())];
 
 	// call user main routine
 	main(argc, argv);
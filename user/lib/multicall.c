@@ -0,0 +1,55 @@
+#include <lib.h>
+
+void multicall_init(struct Multicall_batch *b) {
+	b->mb_n = b->mb_done = 0;
+}
+
+/* Overview:
+ *   Queue syscall 'sysno' with arguments 'a1' to 'a5'. A full batch is run first.
+ *
+ * Post-Condition:
+ *   Return 0, or the error of the syscall which failed when running the full batch.
+ */
+int multicall_add(struct Multicall_batch *b, u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4,
+		  u_int a5) {
+	struct Multicall *mc;
+
+	if (b->mb_n == MULTICALL_MAX) {
+		try(multicall_flush(b));
+	}
+	mc = &b->mb_calls[b->mb_n++];
+	mc->mc_sysno = sysno;
+	mc->mc_args[0] = a1;
+	mc->mc_args[1] = a2;
+	mc->mc_args[2] = a3;
+	mc->mc_args[3] = a4;
+	mc->mc_args[4] = a5;
+	return 0;
+}
+
+/* Overview:
+ *   Run the queued syscalls in one trap, in order, stopping at the first which fails.
+ *
+ * Post-Condition:
+ *   The batch is empty. 'mb_done' is the number of syscalls which succeeded, and their results
+ *   are in 'mb_calls[i].mc_result' until the next 'multicall_add'.
+ *   Return 0 if all of them succeeded, or the error of the one which failed.
+ */
+int multicall_flush(struct Multicall_batch *b) {
+	int r;
+
+	if (b->mb_n == 0) {
+		b->mb_done = 0;
+		return 0;
+	}
+	r = syscall_multicall(b->mb_calls, b->mb_n);
+	if (r < 0) {
+		b->mb_done = 0;
+		b->mb_n = 0;
+		return r;
+	}
+	b->mb_done = r;
+	r = r < b->mb_n ? b->mb_calls[r].mc_result : 0;
+	b->mb_n = 0;
+	return r;
+}
@@ -133,6 +133,7 @@ static int pipe_read(struct Fd *fd, void *vbuf, u_int n, u_int offset) {
 	int i;
 	struct Pipe *p;
 	char *rbuf;
+	u_int delay = POLL_MIN_DELAY;
 
 	// Use 'fd2data' to get the 'Pipe' referred by 'fd'.
 	// Write a loop that transfers one byte in each iteration.
@@ -140,7 +141,7 @@ static int pipe_read(struct Fd *fd, void *vbuf, u_int n, u_int offset) {
 	// When the pipe buffer is empty:
 	//  - If at least 1 byte is read, or the pipe is closed, just return the number
 	//    of bytes read so far.
-	//  - Otherwise, keep yielding until the buffer isn't empty or the pipe is closed.
+	//  - Otherwise, keep sleeping until the buffer isn't empty or the pipe is closed.
 	/* Exercise 6.1: Your code here. (2/3) */
 	p = (struct Pipe *)fd2data(fd);
 	rbuf = (char *)vbuf;
@@ -150,7 +151,7 @@ static int pipe_read(struct Fd *fd, void *vbuf, u_int n, u_int offset) {
 			if (i > 0 || _pipe_is_closed(fd, p)){
 				return i;
 			}
-			syscall_yield();
+			poll_wait(&delay);
 		}
 		rbuf[i] = p->p_buf[p->p_rpos % PIPE_SIZE];
 		p->p_rpos++;
@@ -174,6 +175,7 @@ static int pipe_write(struct Fd *fd, const void *vbuf, u_int n, u_int offset) {
 	int i;
 	struct Pipe *p;
 	char *wbuf;
+	u_int delay;
 
 	// Use 'fd2data' to get the 'Pipe' referred by 'fd'.
 	// Write a loop that transfers one byte in each iteration.
@@ -181,18 +183,19 @@ static int pipe_write(struct Fd *fd, const void *vbuf, u_int n, u_int offset) {
 	// Check if the pipe is closed by '_pipe_is_closed'.
 	// When the pipe buffer is full:
 	//  - If the pipe is closed, just return the number of bytes written so far.
-	//  - If the pipe isn't closed, keep yielding until the buffer isn't full or the
+	//  - If the pipe isn't closed, keep sleeping until the buffer isn't full or the
 	//    pipe is closed.
 	/* Exercise 6.1: Your code here. (3/3) */
 	p = (struct Pipe *)fd2data(fd);
 	wbuf = (char *)vbuf;
 	for (i = 0; i < n;i++){
+		delay = POLL_MIN_DELAY;
 		while (p->p_wpos - p->p_rpos >= PIPE_SIZE)
 		{
 			if (_pipe_is_closed(fd, p)) {
 				return i;
 			}
-			syscall_yield();
+			poll_wait(&delay);
 		}
 		p->p_buf[p->p_wpos % PIPE_SIZE] = wbuf[i];
 		p->p_wpos++;
@@ -133,8 +133,10 @@ void spawn_command(const char *prog, char *aprog)
  *   procedures, D-cache and I-cache writeback/invalidation MUST be performed to maintain cache
  *   coherence, which MOS has NOT implemented. This may result in unexpected behaviours on real
  *   CPUs! QEMU doesn't simulate caching, allowing the OS to function correctly.
+ *
+ *   'spawn' does the same with a single syscall; this one is kept to compare them.
  */
-int spawn(char *prog, char **argv) {
+int uspawn(char *prog, char **argv) {
 	// Step 1: Open the file 'prog' (the path of the program).
 	// Return the error if 'open' fails.
 	int fd;
@@ -223,7 +225,10 @@ int spawn(char *prog, char **argv) {
 		goto err2;
 	}
 
-	// Pages with 'PTE_LIBRARY' set are shared between the parent and the child.
+	// Pages with 'PTE_LIBRARY' set are shared between the parent and the child. The mappings
+	// are made in batches, the last one also making the child runnable.
+	struct Multicall_batch b;
+	multicall_init(&b);
 	for (u_int pdeno = 0; pdeno <= PDX(USTACKTOP); pdeno++) {
 		if (!(vpd[pdeno] & PTE_V)) {
 			continue;
@@ -232,18 +237,19 @@ int spawn(char *prog, char **argv) {
 			u_int pn = (pdeno << 10) + pteno;
 			u_int perm = vpt[pn] & ((1 << PGSHIFT) - 1);
 			if ((perm & PTE_V) && (perm & PTE_LIBRARY)) {
-				void *va = (void *)(pn << PGSHIFT);
+				u_int va = pn << PGSHIFT;
 
-				if ((r = syscall_mem_map(0, va, child, va, perm)) < 0) {
-					debugf("spawn: syscall_mem_map %x %x: %d\n", va, child, r);
+				if ((r = multicall_add(&b, SYS_mem_map, 0, va, child, va, perm)) < 0) {
+					debugf("spawn: syscall_mem_map %x: %d\n", child, r);
 					goto err2;
 				}
 			}
 		}
 	}
 
-	if ((r = syscall_set_env_status(child, ENV_RUNNABLE)) < 0) {
-		debugf("spawn: syscall_set_env_status %x: %d\n", child, r);
+	if ((r = multicall_add(&b, SYS_set_env_status, child, ENV_RUNNABLE, 0, 0, 0)) < 0 ||
+	    (r = multicall_flush(&b)) < 0) {
+		debugf("spawn: cannot share pages with or start %x: %d\n", child, r);
 		goto err2;
 	}
 	return child;
@@ -258,6 +264,31 @@ err:
 	return r;
 }
 
+/* Overview:
+ *   Spawn 'prog' with the arguments 'argv', like 'uspawn', but with the whole image, which
+ *   'open' maps in our memory, loaded into the child by the kernel ('syscall_spawn'). The child
+ *   shares our shared memory but for the file descriptor of 'prog' and its data.
+ *
+ * Post-Condition:
+ *   Return the envid of the child on success, or the error of 'open' or 'syscall_spawn'.
+ */
+int spawn(char *prog, char **argv) {
+	struct Stat st;
+	struct Fd *f;
+	void *image;
+	int fd, r;
+
+	if ((fd = open(prog, O_RDONLY)) < 0) {
+		return fd;
+	}
+	if ((r = fd_lookup(fd, &f)) == 0 && (r = fstat(fd, &st)) == 0 &&
+	    (r = read_map(fd, 0, &image)) == 0) {
+		r = syscall_spawn(image, st.st_size, argv, f);
+	}
+	close(fd);
+	return r;
+}
+
 int spawnl(char *prog, char *args, ...) {
 	// Thanks to MIPS calling convention, the layout of arguments on the stack
 	// are straightforward.
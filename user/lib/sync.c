@@ -0,0 +1,139 @@
+#include <lib.h>
+
+// Atomic operations with 'll' and 'sc'. An exception (a clock interrupt, or any syscall) between
+// them makes 'sc' fail, so the loop only ends once the update happened without interruption.
+
+static u_int atomic_cas(volatile u_int *p, u_int old, u_int new) {
+	u_int cur, tmp;
+
+	asm volatile("1:	ll	%0, %2\n"
+		     "	bne	%0, %3, 2f\n"
+		     "	move	%1, %4\n"
+		     "	sc	%1, %2\n"
+		     "	beqz	%1, 1b\n"
+		     "2:\n"
+		     : "=&r"(cur), "=&r"(tmp), "+m"(*p)
+		     : "r"(old), "r"(new)
+		     : "memory");
+	return cur;
+}
+
+static u_int atomic_xchg(volatile u_int *p, u_int new) {
+	u_int cur, tmp;
+
+	asm volatile("1:	ll	%0, %2\n"
+		     "	move	%1, %3\n"
+		     "	sc	%1, %2\n"
+		     "	beqz	%1, 1b\n"
+		     : "=&r"(cur), "=&r"(tmp), "+m"(*p)
+		     : "r"(new)
+		     : "memory");
+	return cur;
+}
+
+static u_int atomic_add(volatile u_int *p, u_int n) {
+	u_int cur, tmp;
+
+	asm volatile("1:	ll	%0, %2\n"
+		     "	addu	%1, %0, %3\n"
+		     "	sc	%1, %2\n"
+		     "	beqz	%1, 1b\n"
+		     : "=&r"(cur), "=&r"(tmp), "+m"(*p)
+		     : "r"(n)
+		     : "memory");
+	return cur;
+}
+
+void mutex_init(struct Mutex *m) {
+	m->m_state = 0;
+}
+
+int mutex_trylock(struct Mutex *m) {
+	return atomic_cas(&m->m_state, 0, 1) == 0;
+}
+
+/* Overview:
+ *   Lock 'm'. Without contention, this is a single atomic operation and no syscall.
+ *   Otherwise the state is set to 2, so that 'mutex_unlock' knows it has to wake someone.
+ */
+void mutex_lock(struct Mutex *m) {
+	u_int c = atomic_cas(&m->m_state, 0, 1);
+
+	if (c == 0) {
+		return;
+	}
+	if (c != 2) {
+		c = atomic_xchg(&m->m_state, 2);
+	}
+	while (c != 0) {
+		syscall_futex_wait(&m->m_state, 2);
+		c = atomic_xchg(&m->m_state, 2);
+	}
+}
+
+void mutex_unlock(struct Mutex *m) {
+	if (atomic_xchg(&m->m_state, 0) == 2) {
+		syscall_futex_wake(&m->m_state, 1);
+	}
+}
+
+void cond_init(struct Cond *c) {
+	c->c_seq = 0;
+}
+
+/* Overview:
+ *   Unlock 'm', wait for 'cond_signal' or 'cond_broadcast' on 'c', and lock 'm' again.
+ *   A signal between unlocking and waiting changes 'c_seq', so the wait returns at once.
+ *   As with any condition variable, the caller has to check its condition again.
+ */
+void cond_wait(struct Cond *c, struct Mutex *m) {
+	u_int seq = c->c_seq;
+
+	mutex_unlock(m);
+	syscall_futex_wait(&c->c_seq, seq);
+	// Others may be waiting on 'm' too, so lock it as contended.
+	while (atomic_xchg(&m->m_state, 2) != 0) {
+		syscall_futex_wait(&m->m_state, 2);
+	}
+}
+
+void cond_signal(struct Cond *c) {
+	atomic_add(&c->c_seq, 1);
+	syscall_futex_wake(&c->c_seq, 1);
+}
+
+void cond_broadcast(struct Cond *c) {
+	atomic_add(&c->c_seq, 1);
+	syscall_futex_wake(&c->c_seq, ~0u);
+}
+
+void sem_init(struct Sem *s, u_int value) {
+	s->s_value = value;
+	s->s_waiters = 0;
+}
+
+int sem_trywait(struct Sem *s) {
+	u_int v;
+
+	while ((v = s->s_value) > 0) {
+		if (atomic_cas(&s->s_value, v, v - 1) == v) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void sem_wait(struct Sem *s) {
+	while (!sem_trywait(s)) {
+		atomic_add(&s->s_waiters, 1);
+		syscall_futex_wait(&s->s_value, 0);
+		atomic_add(&s->s_waiters, -1);
+	}
+}
+
+void sem_post(struct Sem *s) {
+	atomic_add(&s->s_value, 1);
+	if (s->s_waiters > 0) {
+		syscall_futex_wake(&s->s_value, 1);
+	}
+}
@@ -130,4 +130,102 @@ int syscall_get_all_var(char *buf, int bufsize)
 int syscall_get_parent_id(u_int envid)
 {
 	return msyscall(SYS_get_parent_id, envid);
-}
\ No newline at end of file
+}
+
+int syscall_kmem_info(struct Kmem_info *buf, u_int n)
+{
+	return msyscall(SYS_kmem_info, (u_int)buf, n);
+}
+
+int syscall_swap_info(struct Swap_info *buf)
+{
+	return msyscall(SYS_swap_info, (u_int)buf);
+}
+
+int syscall_ksm_ctl(int rate, struct Ksm_info *buf)
+{
+	return msyscall(SYS_ksm_ctl, rate, (u_int)buf);
+}
+
+int syscall_mem_stat(u_int envid, struct Mem_stat *buf)
+{
+	return msyscall(SYS_mem_stat, envid, (u_int)buf);
+}
+
+int syscall_set_priority(u_int envid, u_int level)
+{
+	return msyscall(SYS_set_priority, envid, level);
+}
+
+int syscall_sleep(u_int cycles)
+{
+	return msyscall(SYS_sleep, cycles);
+}
+
+int syscall_gettime(uint64_t *buf)
+{
+	return msyscall(SYS_gettime, (u_int)buf);
+}
+
+int syscall_futex_wait(volatile u_int *addr, u_int expected)
+{
+	return msyscall(SYS_futex_wait, (u_int)addr, expected);
+}
+
+int syscall_futex_wake(volatile u_int *addr, u_int n)
+{
+	return msyscall(SYS_futex_wake, (u_int)addr, n);
+}
+
+int syscall_multicall(struct Multicall *calls, u_int n)
+{
+	return msyscall(SYS_multicall, (u_int)calls, n);
+}
+
+int syscall_mem_alloc_range(u_int envid, void *va, u_int npages, u_int perm)
+{
+	return msyscall(SYS_mem_alloc_range, envid, (u_int)va, npages, perm);
+}
+
+int syscall_mem_map_range(u_int srcid, void *srcva, u_int dstid, void *dstva, u_int npages,
+			  u_int perm)
+{
+	return msyscall(SYS_mem_map_range, srcid, (u_int)srcva, dstid, (u_int)dstva,
+			perm | npages << PGSHIFT);
+}
+
+int syscall_mem_unmap_range(u_int envid, void *va, u_int npages)
+{
+	return msyscall(SYS_mem_unmap_range, envid, (u_int)va, npages);
+}
+
+int syscall_fork(void)
+{
+	return msyscall(SYS_fork);
+}
+
+int syscall_spawn(const void *image, u_int size, char **argv, const struct Fd *fd)
+{
+	return msyscall(SYS_spawn, image, size, argv, fd);
+}
+
+int syscall_sysstat(u_int envid, struct Sysstat *buf)
+{
+	return msyscall(SYS_sysstat, envid, buf);
+}
+
+int syscall_ipc_call(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva)
+{
+	return msyscall(SYS_ipc_call, envid, value, srcva, perm, dstva);
+}
+
+int syscall_ipc_reply_and_recv(u_int envid, u_int value, const void *srcva, u_int perm,
+							   void *dstva)
+{
+	return msyscall(SYS_ipc_reply_and_recv, envid, value, srcva, perm, dstva);
+}
+
+int syscall_ipc_send(u_int envid, u_int value, const void *srcva, u_int perm)
+{
+	return msyscall(SYS_ipc_send, envid, value, srcva, perm);
+}
@@ -0,0 +1,57 @@
+#include <lib.h>
+
+struct Row {
+	u_int envid;
+	u_int parent;
+	struct Env_mem em;
+};
+
+static struct Row rows[NENV];
+
+static u_int footprint(struct Row *r)
+{
+	return r->em.em_resident + r->em.em_ptpages;
+}
+
+int main(int argc, char **argv)
+{
+	struct Mem_stat ms;
+	int n = 0, i, j;
+
+	ms.ms_free = ms.ms_total = 0;
+	for (i = 0; i < NENV; i++)
+	{
+		if (envs[i].env_status == ENV_FREE || syscall_mem_stat(envs[i].env_id, &ms) < 0)
+		{
+			continue;
+		}
+		rows[n].envid = envs[i].env_id;
+		rows[n].parent = envs[i].env_parent_id;
+		rows[n].em = ms.ms_env;
+		n++;
+	}
+
+	// Largest footprint first.
+	for (i = 1; i < n; i++)
+	{
+		struct Row r = rows[i];
+		for (j = i; j > 0 && footprint(&rows[j - 1]) < footprint(&r); j--)
+		{
+			rows[j] = rows[j - 1];
+		}
+		rows[j] = r;
+	}
+
+	printf("%8s %8s %8s %6s %6s %6s %8s\n", "envid", "parent", "resident", "ptpgs", "shared",
+	       "cow", "KiB");
+	for (i = 0; i < n; i++)
+	{
+		struct Env_mem *em = &rows[i].em;
+		printf("%08x %08x %8d %6d %6d %6d %8d\n", rows[i].envid, rows[i].parent,
+		       em->em_resident, em->em_ptpages, em->em_shared, em->em_cow,
+		       footprint(&rows[i]) * PAGE_SIZE / 1024);
+	}
+	printf("free %d of %d pages (%d of %d KiB)\n", ms.ms_free, ms.ms_total,
+	       ms.ms_free * PAGE_SIZE / 1024, ms.ms_total * PAGE_SIZE / 1024);
+	return 0;
+}
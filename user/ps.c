@@ -0,0 +1,52 @@
+#include <lib.h>
+
+#define SAMPLE_MS 500
+
+static uint64_t cpu0[NENV];
+
+static uint64_t cpu_time(int i)
+{
+	return envs[i].env_utime + envs[i].env_ktime;
+}
+
+static const char *status_name(u_int status)
+{
+	return status == ENV_RUNNABLE ? "run" : "blocked";
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t t0, t1;
+	u_int window, busy = 0;
+	int i;
+
+	// Sample the CPU times twice to get the share of each env over the window.
+	syscall_gettime(&t0);
+	for (i = 0; i < NENV; i++)
+	{
+		cpu0[i] = cpu_time(i);
+	}
+	syscall_sleep(SAMPLE_MS * (KCLOCK_HZ / 1000));
+	syscall_gettime(&t1);
+	window = cycles_to_ms(t1 - t0);
+
+	printf("%8s %8s %7s %3s %8s %9s %9s %5s\n", "envid", "parent", "status", "lvl", "runs",
+	       "user(ms)", "sys(ms)", "%cpu");
+	for (i = 0; i < NENV; i++)
+	{
+		if (envs[i].env_status == ENV_FREE)
+		{
+			continue;
+		}
+		// An env freed and allocated again during the window started over from 0.
+		u_int ms = cpu_time(i) >= cpu0[i] ? cycles_to_ms(cpu_time(i) - cpu0[i]) : 0;
+		busy += ms;
+		printf("%08x %08x %7s %3d %8d %9d %9d %4d%%\n", envs[i].env_id, envs[i].env_parent_id,
+		       status_name(envs[i].env_status), envs[i].env_level, envs[i].env_runs,
+		       cycles_to_ms(envs[i].env_utime), cycles_to_ms(envs[i].env_ktime),
+		       ms * 100 / (window == 0 ? 1 : window));
+	}
+	printf("idle %d%% of the last %d ms\n", busy >= window ? 0 : (window - busy) * 100 / window,
+	       window);
+	return 0;
+}
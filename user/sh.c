@@ -775,6 +775,43 @@ void history()
 	close(fd);
 }
 
+static void print_secs(const char *what, u_int ms)
+{
+	printf("%s %d.%03ds\n", what, ms / 1000, ms % 1000);
+}
+
+/* Overview:
+ *   The 'time' builtin: run 'cmd' like any command line, then print the elapsed time and the
+ *   CPU time used by the envs it ran, in user mode and in the kernel.
+ */
+void time_cmd(char *cmd)
+{
+	uint64_t t0, t1, u0 = env->env_cutime, k0 = env->env_cktime;
+	int r;
+
+	syscall_gettime(&t0);
+	if ((r = fork()) < 0)
+	{
+		user_panic("fork: %d", r);
+	}
+	if (r == 0)
+	{
+		runcmd(cmd);
+		exit(0);
+	}
+	wait(r);
+	// The times of the child reach us when it's freed, right after it told us its status.
+	while (envs[ENVX(r)].env_id == r && envs[ENVX(r)].env_status != ENV_FREE)
+	{
+		syscall_yield();
+	}
+	syscall_gettime(&t1);
+	printf("\n");
+	print_secs("real", cycles_to_ms(t1 - t0));
+	print_secs("user", cycles_to_ms(env->env_cutime - u0));
+	print_secs("sys ", cycles_to_ms(env->env_cktime - k0));
+}
+
 void runcmd(char *s)
 {
 	gettoken(s, 0);
@@ -1242,6 +1279,11 @@ int main(int argc, char **argv)
 			exit(0);
 			break; // 直接退出循环
 		}
+		if (startswith(buf, "time "))
+		{
+			time_cmd(buf + 5);
+			continue;
+		}
 		if (startswith(buf, "cd") || startswith(buf, "pwd") || startswith(buf, "declare") || startswith(buf, "unset") || startswith(buf, "history"))
 		{
 			runcmd(buf);
@@ -0,0 +1,30 @@
+#include <lib.h>
+
+#define MAX_CACHES 32
+
+static struct Kmem_info info[MAX_CACHES];
+
+int main(int argc, char **argv)
+{
+	int n = syscall_kmem_info(info, MAX_CACHES);
+	if (n < 0)
+	{
+		printf("slabinfo: %d\n", n);
+		return 1;
+	}
+	if (n > MAX_CACHES)
+	{
+		n = MAX_CACHES;
+	}
+
+	printf("%-16s %7s %7s %6s %6s %8s %8s %6s\n", "name", "objsize", "perslab", "slabs", "inuse",
+	       "allocs", "frees", "fails");
+	for (int i = 0; i < n; i++)
+	{
+		struct Kmem_info *ki = &info[i];
+		printf("%-16s %7d %7d %6d %6d %8d %8d %6d\n", ki->ki_name, ki->ki_objsize,
+		       ki->ki_objs_per_slab, ki->ki_slabs, ki->ki_inuse, ki->ki_allocs, ki->ki_frees,
+		       ki->ki_fails);
+	}
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include <lib.h>
+
+#define NTOP 10
+
+static const char *names[MAX_SYSNO] = {
+	[SYS_putchar] = "putchar",
+	[SYS_print_cons] = "print_cons",
+	[SYS_getenvid] = "getenvid",
+	[SYS_yield] = "yield",
+	[SYS_env_destroy] = "env_destroy",
+	[SYS_set_tlb_mod_entry] = "set_tlb_mod_entry",
+	[SYS_mem_alloc] = "mem_alloc",
+	[SYS_mem_map] = "mem_map",
+	[SYS_mem_unmap] = "mem_unmap",
+	[SYS_exofork] = "exofork",
+	[SYS_set_env_status] = "set_env_status",
+	[SYS_set_trapframe] = "set_trapframe",
+	[SYS_panic] = "panic",
+	[SYS_ipc_try_send] = "ipc_try_send",
+	[SYS_ipc_recv] = "ipc_recv",
+	[SYS_cgetc] = "cgetc",
+	[SYS_write_dev] = "write_dev",
+	[SYS_read_dev] = "read_dev",
+	[SYS_get_cwd] = "get_cwd",
+	[SYS_chdir] = "chdir",
+	[SYS_alloc_shell_id] = "alloc_shell_id",
+	[SYS_declare_var] = "declare_var",
+	[SYS_unset_var] = "unset_var",
+	[SYS_get_var] = "get_var",
+	[SYS_get_all_var] = "get_all_var",
+	[SYS_get_parent_id] = "get_parent_id",
+	[SYS_kmem_info] = "kmem_info",
+	[SYS_swap_info] = "swap_info",
+	[SYS_ksm_ctl] = "ksm_ctl",
+	[SYS_mem_stat] = "mem_stat",
+	[SYS_set_priority] = "set_priority",
+	[SYS_sleep] = "sleep",
+	[SYS_gettime] = "gettime",
+	[SYS_futex_wait] = "futex_wait",
+	[SYS_futex_wake] = "futex_wake",
+	[SYS_multicall] = "multicall",
+	[SYS_mem_alloc_range] = "mem_alloc_range",
+	[SYS_mem_map_range] = "mem_map_range",
+	[SYS_mem_unmap_range] = "mem_unmap_range",
+	[SYS_fork] = "fork",
+	[SYS_spawn] = "spawn",
+	[SYS_sysstat] = "sysstat",
+	[SYS_ipc_call] = "ipc_call",
+	[SYS_ipc_reply_and_recv] = "ipc_reply_and_recv",
+	[SYS_ipc_send] = "ipc_send",
+};
+
+static struct Sysstat ss;
+
+static void usage(void)
+{
+	printf("usage: sysstat [envid]\n");
+	exit(1);
+}
+
+static u_int parse_hex(const char *s)
+{
+	u_int v = 0;
+
+	if (*s == '\0')
+	{
+		usage();
+	}
+	for (; *s; s++)
+	{
+		if (*s >= '0' && *s <= '9')
+		{
+			v = v * 16 + *s - '0';
+		}
+		else if (*s >= 'a' && *s <= 'f')
+		{
+			v = v * 16 + *s - 'a' + 10;
+		}
+		else
+		{
+			usage();
+		}
+	}
+	return v;
+}
+
+// Cycles per call, without a 64-bit division: both are shifted until the cycles fit in 32 bits.
+static u_int avg_cycles(struct Sysstat_call *sc)
+{
+	uint64_t cycles = sc->sc_cycles;
+	u_int shift = 0;
+
+	while (cycles >> 32)
+	{
+		cycles >>= 1;
+		shift++;
+	}
+	return (u_int)cycles / sc->sc_count << shift;
+}
+
+// The upper bound (in cycles) of the histogram bucket holding the 'pct'th percentile of 'hist'.
+static u_int percentile(const u_int *hist, u_int count, u_int pct)
+{
+	u_int seen = 0, i;
+
+	for (i = 0; i < SYSSTAT_NBUCKETS - 1; i++)
+	{
+		seen += hist[i];
+		if (seen * 100 >= count * pct)
+		{
+			break;
+		}
+	}
+	return i == SYSSTAT_NBUCKETS - 1 ? ~0u : 2u << i;
+}
+
+/* Overview:
+ *   Print the syscalls that took the most time, system-wide, or only those of the env given
+ *   (in hex) as the argument, with their latency percentiles rounded up to a power of 2.
+ */
+int main(int argc, char **argv)
+{
+	struct Sysstat_call *calls = ss.ss_all;
+	u_int(*hists)[SYSSTAT_NBUCKETS] = ss.ss_hist;
+	u_int envid = 0, order[MAX_SYSNO], n = 0, i, j, t;
+	int r;
+
+	if (argc > 2)
+	{
+		usage();
+	}
+	if (argc == 2)
+	{
+		envid = parse_hex(argv[1]);
+		calls = ss.ss_env;
+		hists = ss.ss_env_hist;
+	}
+	if ((r = syscall_sysstat(envid, &ss)) < 0)
+	{
+		printf("sysstat: %d\n", r);
+		return 1;
+	}
+
+	for (i = 0; i < MAX_SYSNO; i++)
+	{
+		if (calls[i].sc_count != 0)
+		{
+			order[n++] = i;
+		}
+	}
+	// Most cycles first.
+	for (i = 1; i < n; i++)
+	{
+		t = order[i];
+		for (j = i; j > 0 && calls[order[j - 1]].sc_cycles < calls[t].sc_cycles; j--)
+		{
+			order[j] = order[j - 1];
+		}
+		order[j] = t;
+	}
+
+	printf("%-18s %8s %8s %8s %10s %10s\n", "syscall", "calls", "ms", "avg", "p50<=", "p99<=");
+	for (i = 0; i < n && i < NTOP; i++)
+	{
+		struct Sysstat_call *sc = &calls[order[i]];
+		u_int *hist = hists[order[i]];
+		u_int count = sc->sc_count;
+
+		printf("%-18s %8u %8u %8u %10u %10u\n", names[order[i]] ? names[order[i]] : "?",
+		       sc->sc_count, cycles_to_ms(sc->sc_cycles), avg_cycles(sc),
+		       percentile(hist, count, 50), percentile(hist, count, 99));
+	}
+	return 0;
+}